@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <assert.h>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <taskparts/algorithms.hpp>
+#include <taskparts/benchmark.hpp>
+
+/* Runs each primitive of algorithms.hpp on n pseudorandom keys, and
+ * reports the time taken by each: pass -algorithm reduce, scan,
+ * filter, histogram, merge, or sort to run just one of them (by
+ * default, all of them). Debug builds check each result against its
+ * sequential counterpart.
+ */
+int main() {
+  size_t n = taskparts::cmdline::parse_or_default_long("n", 10 * 1000 * 1000);
+  size_t nb_buckets = taskparts::cmdline::parse_or_default_long("nb_buckets", 1024);
+  auto algorithm = taskparts::cmdline::parse_or_default_string("algorithm", "all");
+  auto runs = [&] (const char* a) {
+    return (algorithm == "all") || (algorithm == a);
+  };
+  std::vector<uint64_t> xs, ys, zs;
+  std::vector<size_t> counts;
+  uint64_t sum = 0;
+  size_t nb_kept = 0;
+  auto plus = [] (uint64_t x, uint64_t y) { return x + y; };
+  auto is_even = [] (uint64_t x) { return (x % 2) == 0; };
+  auto less = std::less<uint64_t>();
+  auto timed = [&] (const char* a, const auto& f) {
+    if (! runs(a)) {
+      return;
+    }
+    auto st = taskparts::steadyclock::now();
+    f();
+    printf("%s_secs %.3f\n", a, taskparts::steadyclock::since(st));
+  };
+  taskparts::benchmark_nativeforkjoin([&] (auto sched) {
+    taskparts::tabulate(0, n, [&] (size_t i) {
+      return taskparts::hash(i) % n;
+    }, xs.begin(), sched);
+    timed("reduce", [&] {
+      sum = taskparts::reduce(0, n, (uint64_t)0, plus, [&] (size_t i) { return xs[i]; }, sched);
+    });
+    timed("scan", [&] {
+      taskparts::scan(0, n, (uint64_t)0, plus, [&] (size_t i) { return xs[i]; }, ys.begin(), sched);
+    });
+    timed("filter", [&] {
+      nb_kept = taskparts::filter(xs.begin(), n, is_even, zs.begin(), sched);
+    });
+    timed("histogram", [&] {
+      taskparts::histogram(0, n, nb_buckets, [&] (size_t i) { return xs[i] % nb_buckets; },
+			   counts.begin(), sched);
+    });
+    timed("sort", [&] {
+      taskparts::sample_sort(xs.begin(), n, less, sched);
+    });
+    timed("merge", [&] {
+      // merges the two sorted halves of the sorted keys
+      auto h = n / 2;
+      taskparts::merge(xs.begin(), h, xs.begin() + h, n - h, ys.begin(), less, sched);
+    });
+  }, [&] (auto sched) {
+    xs.resize(n);
+    ys.resize(n);
+    zs.resize(n);
+    counts.resize(nb_buckets);
+  }, [&] (auto sched) {
+#ifndef NDEBUG
+    std::vector<uint64_t> xs2(n);
+    for (size_t i = 0; i < n; i++) {
+      xs2[i] = taskparts::hash(i) % n;
+    }
+    if (runs("reduce")) {
+      assert(sum == std::accumulate(xs2.begin(), xs2.end(), (uint64_t)0));
+    }
+    if (runs("scan") && ! runs("merge")) {
+      uint64_t acc = 0;
+      for (size_t i = 0; i < n; i++) {
+	assert(ys[i] == acc);
+	acc += xs2[i];
+      }
+    }
+    if (runs("filter")) {
+      std::vector<uint64_t> zs2;
+      std::copy_if(xs2.begin(), xs2.end(), std::back_inserter(zs2), is_even);
+      assert(nb_kept == zs2.size());
+      assert(std::equal(zs2.begin(), zs2.end(), zs.begin()));
+    }
+    if (runs("histogram")) {
+      std::vector<size_t> counts2(nb_buckets, 0);
+      for (auto x : xs2) {
+	counts2[x % nb_buckets]++;
+      }
+      assert(counts2 == counts);
+    }
+    std::sort(xs2.begin(), xs2.end());
+    if (runs("sort")) {
+      assert(xs == xs2);
+    }
+    if (runs("merge") && runs("sort")) {
+      assert(ys == xs2);
+    }
+#endif
+  });
+  printf("result %lu\n", sum);
+  return 0;
+}
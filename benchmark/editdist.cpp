@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "../example/editdist.hpp"
+#include <taskparts/benchmark.hpp>
+#include <taskparts/hash.hpp>
+
+/* Minimum edit distance of two random strings of length n, either by
+ * bulk-synchronous phases, one per anti-diagonal of blocks (-variant
+ * phases), or by a task graph of blocks (-variant taskgraph, the
+ * default); see example/editdist.hpp.
+ */
+int main() {
+  size_t n = taskparts::cmdline::parse_or_default_long("n", 8000);
+  size_t block = taskparts::cmdline::parse_or_default_long("block", 256);
+  auto variant = taskparts::cmdline::parse_or_default_string("variant", "taskgraph");
+  std::vector<char> a, b;
+  int dst = -1;
+  taskparts::benchmark_nativeforkjoin([&] (auto sched) {
+    if (variant == "phases") {
+      dst = editdist_phases(a, b, block, sched);
+    } else {
+      dst = editdist_taskgraph(a, b, block, sched);
+    }
+  }, [&] (auto sched) {
+    a.resize(n);
+    b.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      a[i] = 'a' + (taskparts::hash(i) % 4);
+      b[i] = 'a' + (taskparts::hash(i + n) % 4);
+    }
+  }, [&] (auto sched) {
+#ifndef NDEBUG
+    assert(dst == editdist_serial(a, b));
+#endif
+  });
+  printf("result %d\n", dst);
+  return 0;
+}
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+
+#include "../example/fanin.hpp"
+#include <taskparts/benchmark.hpp>
+
+/* Microbenchmark of the throughput of the releases of a join fiber by
+ * its predecessors, as a function of the fan-in degree of the join
+ * fiber: for each degree 2^k, with k from 0 to max_fanin_lg, spawns
+ * 2^k fibers that all have an edge to a single join fiber, and reports
+ * the wall-clock time divided by the degree. Pass -incounter snzi to
+ * measure the in-counter of fanin_fiber (see fanin.hpp), or -incounter
+ * counter (the default) to measure the plain atomic counter of fiber.
+ */
+int main() {
+  size_t max_fanin_lg = taskparts::cmdline::parse_or_default_long("max_fanin_lg", 20);
+  auto incounter = taskparts::cmdline::parse_or_default_string("incounter", "counter");
+  std::vector<double> elapsed(max_fanin_lg + 1, 0.0);
+  taskparts::benchmark_nativeforkjoin([&] (auto sched) {
+    using scheduler_type = decltype(sched);
+    for (size_t k = 0; k <= max_fanin_lg; k++) {
+      size_t nb = (size_t)1 << k;
+      auto st = taskparts::steadyclock::now();
+      if (incounter == "snzi") {
+	taskparts::fork1fiberjoin(new fanin_join<fanin_snzi_fiber, scheduler_type>(nb, sched));
+      } else {
+	taskparts::fork1fiberjoin(new fanin_join<taskparts::fiber, scheduler_type>(nb, sched));
+      }
+      elapsed[k] = taskparts::steadyclock::since(st);
+    }
+  });
+  printf("result %lu\n", max_fanin_lg);
+  printf("incounter %s\n", incounter.c_str());
+  for (size_t k = 0; k <= max_fanin_lg; k++) {
+    size_t nb = (size_t)1 << k;
+    printf("fanin %lu ns_per_release %.2f\n", nb, (elapsed[k] * 1.0e9) / (double)nb);
+  }
+  return 0;
+}
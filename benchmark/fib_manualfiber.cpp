@@ -4,13 +4,38 @@
 #include "../example/fib_manualfiber.hpp"
 #include <taskparts/benchmark.hpp>
 
+/* Microbenchmark of the footprint and spawn cost of fibers: reports
+ * the number of bytes taken by each fiber, and the wall-clock time of
+ * the last run divided by the number of fibers it created. Pass
+ * -fiber crtp to measure fibers with static dispatch, and compile
+ * with -DTASKPARTS_USE_COMPACT_FIBER_LAYOUT to measure the compact
+ * layout.
+ */
 int main() {
   int64_t n = taskparts::cmdline::parse_or_default_long("n", 44);
+  fib_serial_threshold = taskparts::cmdline::parse_or_default_long("threshold", fib_serial_threshold);
+  auto fiber_kind = taskparts::cmdline::parse_or_default_string("fiber", "virtual");
   int64_t dst;
+  double elapsed = 0.0;
+  size_t fiber_szb = 0;
   taskparts::benchmark_nativeforkjoin([&] (auto sched) {
-    taskparts::fork1fiberjoin(new fib_manualfiber(n, &dst, sched));
+    using scheduler_type = decltype(sched);
+    auto st = taskparts::steadyclock::now();
+    if (fiber_kind == "crtp") {
+      fiber_szb = sizeof(fib_crtpfiber<scheduler_type>);
+      taskparts::fork1fiberjoin(new fib_crtpfiber(n, &dst, sched));
+    } else {
+      fiber_szb = sizeof(fib_manualfiber<scheduler_type>);
+      taskparts::fork1fiberjoin(new fib_manualfiber(n, &dst, sched));
+    }
+    elapsed = taskparts::steadyclock::since(st);
   });
   printf("result %lu\n",dst);
+  auto nb_fibers = fib_manualfiber_nb_fibers(n);
+  printf("fiber_szb %lu\n", fiber_szb);
+  printf("fiber_footprint_szb %lu\n", taskparts::fiber_pools::footprint_szb(fiber_szb));
+  printf("nb_fibers %ld\n", nb_fibers);
+  printf("ns_per_fiber %.2f\n", (elapsed * 1.0e9) / (double)nb_fibers);
   assert(dst == fib_serial(n));
   return 0;
 }
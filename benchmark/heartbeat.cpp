@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+
+#include <taskparts/heartbeat.hpp>
+#include <taskparts/benchmark.hpp>
+
+/* Heartbeat loops of heartbeat.hpp on an array of n ones: a
+ * heartbeat_parallel_for() that fills the array, a heartbeat_scan()
+ * of its prefix sums, and a heartbeat_reduce() of its sum. The
+ * environment variables TASKPARTS_KAPPA_USEC and
+ * TASKPARTS_HEARTBEAT_POLLING_INTERVAL control the heartbeat.
+ */
+int main() {
+  size_t n = taskparts::cmdline::parse_or_default_long("n", 100 * 1000 * 1000);
+  std::vector<int64_t> xs, ys;
+  int64_t dst = 0;
+  int64_t total = 0;
+  taskparts::benchmark_nativeforkjoin([&] (auto sched) {
+    auto plus = [] (int64_t x, int64_t y) { return x + y; };
+    taskparts::heartbeat_parallel_for(0, n, [&] (size_t i) {
+      xs[i] = 1;
+    }, sched);
+    total = taskparts::heartbeat_scan(0, n, (int64_t)0, (int64_t)0, plus, [&] (size_t i) {
+      return xs[i];
+    }, ys.begin(), sched);
+    dst = taskparts::heartbeat_reduce(0, n, (int64_t)0, plus, [&] (size_t i) {
+      return ys[i];
+    }, sched);
+  }, [&] (auto sched) {
+    xs.resize(n);
+    ys.resize(n);
+  }, [&] (auto sched) {
+    assert(total == (int64_t)n);
+    for (size_t i = 0; i < n; i++) {
+      assert(ys[i] == (int64_t)(i + 1));
+    }
+    assert(dst == (int64_t)((n * (n + 1)) / 2));
+  });
+  printf("result %ld\n", dst);
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+
+#include <taskparts/lazysplitting.hpp>
+#include <taskparts/hash.hpp>
+#include <taskparts/benchmark.hpp>
+
+/* A loop of irregular iterations, iteration i hashing its index
+ * (i % irregularity) times, run by lazy_parallel_for(), followed by
+ * a sum of the results by lazy_parallel_reduce() (see
+ * lazysplitting.hpp). With stats enabled, nb_fibers reports how many
+ * times the loops split.
+ */
+auto irregular_iteration(size_t i, size_t irregularity) -> uint64_t {
+  uint64_t h = i;
+  for (size_t k = 0; k < (i % irregularity); k++) {
+    h = taskparts::hash(h);
+  }
+  return h;
+}
+
+int main() {
+  size_t n = taskparts::cmdline::parse_or_default_long("n", 10000000);
+  size_t irregularity = taskparts::cmdline::parse_or_default_long("irregularity", 64);
+  std::vector<uint64_t> xs;
+  uint64_t dst = 0;
+  taskparts::benchmark_nativeforkjoin([&] (auto sched) {
+    taskparts::lazy_parallel_for(0, n, [&] (size_t i) {
+      xs[i] = irregular_iteration(i, irregularity);
+    }, sched);
+    dst = taskparts::lazy_parallel_reduce(0, n, (uint64_t)0, [] (uint64_t x, uint64_t y) {
+      return x + y;
+    }, [&] (size_t i) {
+      return xs[i];
+    }, sched);
+  }, [&] (auto sched) {
+    xs.resize(n);
+  }, [&] (auto sched) {
+#ifndef NDEBUG
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; i++) {
+      r += irregular_iteration(i, irregularity);
+    }
+    assert(r == dst);
+#endif
+  });
+  printf("result %lu\n", dst);
+  return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <assert.h>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "../example/fib_nativeforkjoin.hpp"
+#include <taskparts/pool.hpp>
+#include <taskparts/benchmark.hpp>
+
+/* Microbenchmark of the worker pools of pool.hpp: starts two pools of
+ * distinct tags, each with nb_workers workers, and then has
+ * nb_submitters threads that are not workers submit nb_jobs jobs each,
+ * alternating between the two pools. Every job computes fib(n) with
+ * fork2join(). Most jobs go through submit(), every fourth through
+ * submit_and_wait(), and every eighth is a void job whose future is
+ * dropped, and which therefore only shutdown() waits for. Reports the
+ * wall-clock time from the first submission to the end of the
+ * shutdown of both pools. Debug builds check every result.
+ */
+struct ingest { };
+struct analytics { };
+
+int main() {
+  int64_t n = taskparts::cmdline::parse_or_default_long("n", 20);
+  size_t nb_jobs = taskparts::cmdline::parse_or_default_long("nb_jobs", 1000);
+  size_t nb_submitters = taskparts::cmdline::parse_or_default_long("nb_submitters", 4);
+  size_t nb_workers = taskparts::cmdline::parse_or_default_long("nb_workers", 2);
+  auto expected = fib_serial(n);
+  taskparts::pool<ingest> p1(nb_workers);
+  taskparts::pool<analytics> p2(nb_workers);
+  std::atomic<size_t> nb_void_jobs_done(0);
+  std::atomic<size_t> nb_bad_results(0);
+  size_t nb_void_jobs = 0;
+  auto st = taskparts::steadyclock::now();
+  std::vector<std::thread> submitters;
+  for (size_t s = 0; s < nb_submitters; s++) {
+    submitters.emplace_back([&, s] {
+      std::vector<std::future<int64_t>> results;
+      auto job = [&] (auto sched) { return fib_nativeforkjoin(n, sched); };
+      auto void_job = [&] (auto sched) {
+        if (fib_nativeforkjoin(n, sched) != expected) {
+          nb_bad_results++;
+        }
+        nb_void_jobs_done++;
+      };
+      for (size_t j = 0; j < nb_jobs; j++) {
+        // alternate pools, starting from a distinct one in each submitter
+        bool first = ((j + s) % 2) == 0;
+        if ((j % 8) == 7) {
+          first ? (void)p1.submit(void_job) : (void)p2.submit(void_job);
+        } else if ((j % 4) == 3) {
+          auto r = first ? p1.submit_and_wait(job) : p2.submit_and_wait(job);
+          if (r != expected) {
+            nb_bad_results++;
+          }
+        } else {
+          results.push_back(first ? p1.submit(job) : p2.submit(job));
+        }
+      }
+      for (auto& r : results) {
+        if (r.get() != expected) {
+          nb_bad_results++;
+        }
+      }
+    });
+  }
+  for (size_t j = 0; j < nb_jobs; j++) {
+    nb_void_jobs += ((j % 8) == 7) ? nb_submitters : 0;
+  }
+  for (auto& t : submitters) {
+    t.join();
+  }
+  p1.shutdown();
+  p2.shutdown();
+  auto elapsed = taskparts::steadyclock::since(st);
+  printf("result %lu\n", nb_submitters * nb_jobs);
+  printf("exectime %.3f\n", elapsed);
+  printf("us_per_job %.2f\n", (elapsed * 1.0e6) / (double)(nb_submitters * nb_jobs));
+  assert(nb_bad_results.load() == 0);
+  assert(nb_void_jobs_done.load() == nb_void_jobs);
+  return 0;
+}
@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <taskparts/logging.hpp>
+#include <taskparts/cmdline.hpp>
+
+/* Replays the DAG of strands recorded in a trace stream under a
+ * simulated work-stealing scheduler, and predicts the makespan and the
+ * idle time of the replay, e.g.:
+ *
+ *   TASKPARTS_LOGGING_STREAM=trace.bin TASKPARTS_LOGGING_FIBERS=1 bin/fib_nativeforkjoin.log
+ *   bin/schedsim.opt -input trace.bin -proc 256 -steal_cycles 2000
+ *
+ * A strand is one call to exec() of a fiber by a worker, delimited in
+ * the trace by fiber_enter and fiber_exit, and takes in the replay the
+ * cycles that it took in the recorded run. Strand k of fiber f depends
+ * on strand k-1 of f, on the strand that made f ready (by
+ * fiber_release), and on the last strand of each predecessor of f
+ * added by fiber_add_edge before strand k. When a strand completes,
+ * the strands that it makes ready are pushed on the deque of its
+ * worker, in the order in which they were released in the recorded
+ * run, so that, as in the runtime, the last one released runs next.
+ *
+ * The simulated workers pop from the bottom of their own deque and
+ * steal from the top of the deques of others, which is the discipline
+ * that all the deques of the runtime share (abp, chaselev, ywra); they
+ * differ by the costs of their operations, which are parameters of
+ * the simulation (-push_cycles, -pop_cycles, -steal_cycles, the latter
+ * of which is the latency of a steal attempt, successful or not). A
+ * thief picks its victims as by TASKPARTS_VICTIM_SELECTION (-victim
+ * uniform, last_victim, two_choices, or round_robin) and steals up to
+ * -steal_batch strands at a time.
+ */
+
+using namespace taskparts;
+
+using strand_type = struct strand_struct {
+  uint64_t start;
+  uint64_t duration;
+  std::vector<size_t> successors;
+  size_t nb_deps;
+};
+
+// builds the DAG of strands of the merged events of all workers,
+// sorted by timestamp, and returns the recorded makespan
+auto build_dag(std::vector<event_type>& events, size_t nb_workers,
+               std::vector<strand_type>& strands) -> uint64_t {
+  // fibers are numbered as in output_json() (see logging.hpp)
+  std::unordered_map<void*, size_t> fiber_ids;
+  size_t nb_fiber_ids = 0;
+  auto fiber_id = [&] (void* p, bool is_new) -> size_t {
+    auto it = fiber_ids.find(p);
+    if (is_new || (it == fiber_ids.end())) {
+      auto n = ++nb_fiber_ids;
+      fiber_ids[p] = n;
+      return n;
+    }
+    return it->second;
+  };
+  const size_t no_strand = ~((size_t)0);
+  using fiber_state_type = struct fiber_state_struct {
+    size_t last_strand = ~((size_t)0);
+    // strands on which the next strand of the fiber depends
+    std::vector<size_t> deps;
+    // fibers on whose last strand the next strand depends
+    std::vector<size_t> preds;
+  };
+  std::unordered_map<size_t, fiber_state_type> fibers;
+  std::vector<size_t> current(nb_workers, no_strand);
+  std::vector<size_t> current_fiber(nb_workers, 0);
+  // edges from the last strand of a fiber, resolved at the end
+  std::vector<std::pair<size_t, size_t>> pred_edges;
+  uint64_t first = ~((uint64_t)0), last = 0;
+  for (auto& e : events) {
+    if (! e.is_fiber_event()) {
+      continue;
+    }
+    auto w = e.worker_id;
+    auto& fe = e.extra.fiber_event;
+    switch (e.tag) {
+      case fiber_create: {
+        fiber_id(fe.f, true);
+        break;
+      }
+      case fiber_add_edge: {
+        fibers[fiber_id(fe.g, false)].preds.push_back(fiber_id(fe.f, false));
+        break;
+      }
+      case fiber_release: {
+        if (current[w] != no_strand) {
+          fibers[fiber_id(fe.f, false)].deps.push_back(current[w]);
+        }
+        break;
+      }
+      case fiber_enter: {
+        auto f = fiber_id(fe.f, false);
+        auto& fs = fibers[f];
+        auto s = strands.size();
+        strands.push_back(strand_type{e.cycle_count, 0, {}, 0});
+        if (fs.last_strand != no_strand) {
+          fs.deps.push_back(fs.last_strand);
+        }
+        for (auto d : fs.deps) {
+          strands[d].successors.push_back(s);
+        }
+        for (auto p : fs.preds) {
+          pred_edges.push_back(std::make_pair(p, s));
+        }
+        fs.deps.clear();
+        fs.preds.clear();
+        fs.last_strand = s;
+        current[w] = s;
+        current_fiber[w] = f;
+        first = std::min(first, e.cycle_count);
+        break;
+      }
+      case fiber_exit: {
+        if (current[w] != no_strand) {
+          auto& s = strands[current[w]];
+          s.duration = e.cycle_count - s.start;
+          last = std::max(last, e.cycle_count);
+        }
+        current[w] = no_strand;
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+  for (auto& pe : pred_edges) {
+    auto it = fibers.find(pe.first);
+    if ((it != fibers.end()) && (it->second.last_strand != no_strand)) {
+      strands[it->second.last_strand].successors.push_back(pe.second);
+    }
+  }
+  // strands are numbered in the order of their start, which is thus a
+  // topological order; drop duplicate and backward edges
+  for (size_t i = 0; i < strands.size(); i++) {
+    auto& ss = strands[i].successors;
+    std::vector<size_t> ss2;
+    for (auto j : ss) {
+      if ((j > i) && (std::find(ss2.begin(), ss2.end(), j) == ss2.end())) {
+        ss2.push_back(j);
+        strands[j].nb_deps++;
+      }
+    }
+    ss.swap(ss2);
+  }
+  return (first <= last) ? (last - first) : 0;
+}
+
+int main() {
+  auto input = cmdline::parse_string("input");
+  std::vector<buffer_type> bs;
+  size_t nb_dropped;
+  if (! read_trace_stream(input, bs, nb_dropped)) {
+    fprintf(stderr, "%s is not a trace stream\n", input.c_str());
+    return 1;
+  }
+  if (nb_dropped > 0) {
+    fprintf(stderr, "warning: %lu events were dropped, so the DAG is incomplete\n", nb_dropped);
+  }
+  size_t nb_procs = cmdline::parse_or_default_long("proc", bs.size());
+  uint64_t push_cycles = cmdline::parse_or_default_long("push_cycles", 0);
+  uint64_t pop_cycles = cmdline::parse_or_default_long("pop_cycles", 0);
+  uint64_t steal_cycles = std::max(1l, cmdline::parse_or_default_long("steal_cycles", 1000));
+  size_t steal_batch = std::max(1l, cmdline::parse_or_default_long("steal_batch", 1));
+  auto victim = cmdline::parse_or_default_string("victim", "uniform");
+  std::mt19937_64 rng(cmdline::parse_or_default_long("seed", 0));
+  if ((victim != "uniform") && (victim != "last_victim") &&
+      (victim != "two_choices") && (victim != "round_robin")) {
+    fprintf(stderr, "unknown victim selection %s\n", victim.c_str());
+    return 1;
+  }
+
+  // DAG
+  std::vector<event_type> events;
+  for (auto& b : bs) {
+    events.insert(events.end(), b.begin(), b.end());
+  }
+  std::stable_sort(events.begin(), events.end(), [] (const event_type& e1, const event_type& e2) {
+    return e1.cycle_count < e2.cycle_count;
+  });
+  std::vector<strand_type> strands;
+  auto recorded_makespan = build_dag(events, bs.size(), strands);
+  uint64_t work = 0, span = 0;
+  {
+    std::vector<uint64_t> finish(strands.size(), 0);
+    for (size_t i = 0; i < strands.size(); i++) {
+      finish[i] += strands[i].duration;
+      work += strands[i].duration;
+      span = std::max(span, finish[i]);
+      for (auto j : strands[i].successors) {
+        finish[j] = std::max(finish[j], finish[i]);
+      }
+    }
+  }
+
+  // simulation
+  using worker_type = struct worker_struct {
+    std::deque<size_t> deque;
+    size_t running;     // strand that completes at the next event, if any
+    size_t target;      // victim of the steal attempt that completes then, if any
+    size_t last_victim;
+    size_t next_victim;
+  };
+  const size_t none = ~((size_t)0);
+  std::vector<worker_type> workers(nb_procs, worker_type{{}, none, none, none, 0});
+  std::vector<size_t> nb_deps(strands.size());
+  for (size_t i = 0; i < strands.size(); i++) {
+    nb_deps[i] = strands[i].nb_deps;
+    if (nb_deps[i] == 0) {
+      workers[0].deque.push_back(i);
+    }
+  }
+  using sim_event_type = std::pair<uint64_t, size_t>; // (time, worker)
+  std::priority_queue<sim_event_type, std::vector<sim_event_type>, std::greater<sim_event_type>> q;
+  for (size_t w = 0; w < nb_procs; w++) {
+    q.push(std::make_pair(0, w));
+  }
+  size_t nb_completed = 0;
+  uint64_t makespan = 0, steal_time = 0;
+  size_t nb_steals = 0, nb_failed_steals = 0;
+  auto select_victim = [&] (size_t w) -> size_t {
+    std::uniform_int_distribution<size_t> d(0, nb_procs - 2);
+    auto random_other = [&] {
+      auto v = d(rng);
+      return (v >= w) ? v + 1 : v;
+    };
+    auto& wk = workers[w];
+    if ((victim == "last_victim") && (wk.last_victim != none)) {
+      return wk.last_victim;
+    } else if (victim == "two_choices") {
+      auto v1 = random_other();
+      auto v2 = random_other();
+      return (workers[v1].deque.size() >= workers[v2].deque.size()) ? v1 : v2;
+    } else if (victim == "round_robin") {
+      wk.next_victim = (wk.next_victim + 1) % nb_procs;
+      if (wk.next_victim == w) {
+        wk.next_victim = (wk.next_victim + 1) % nb_procs;
+      }
+      return wk.next_victim;
+    }
+    return random_other();
+  };
+  while ((nb_completed < strands.size()) && ! q.empty()) {
+    auto t = q.top().first;
+    auto w = q.top().second;
+    q.pop();
+    auto& wk = workers[w];
+    if (wk.running != none) {
+      // completion of a strand
+      auto s = wk.running;
+      wk.running = none;
+      nb_completed++;
+      makespan = std::max(makespan, t);
+      for (auto j : strands[s].successors) {
+        if (--nb_deps[j] == 0) {
+          wk.deque.push_back(j);
+          t += push_cycles;
+        }
+      }
+    } else if (wk.target != none) {
+      // completion of a steal attempt
+      auto& v = workers[wk.target];
+      steal_time += steal_cycles;
+      if (v.deque.empty()) {
+        nb_failed_steals++;
+        wk.last_victim = none;
+      } else {
+        nb_steals++;
+        wk.last_victim = wk.target;
+        for (size_t i = 0; (i < steal_batch) && ! v.deque.empty(); i++) {
+          wk.deque.push_back(v.deque.front());
+          v.deque.pop_front();
+        }
+        // the oldest stolen strand runs first
+        std::reverse(wk.deque.begin(), wk.deque.end());
+      }
+      wk.target = none;
+    }
+    if (! wk.deque.empty()) {
+      auto s = wk.deque.back();
+      wk.deque.pop_back();
+      wk.running = s;
+      q.push(std::make_pair(t + pop_cycles + strands[s].duration, w));
+    } else if (nb_procs > 1) {
+      wk.target = select_victim(w);
+      q.push(std::make_pair(t + steal_cycles, w));
+    }
+  }
+  if (nb_completed < strands.size()) {
+    fprintf(stderr, "error: %lu strands could not run\n", strands.size() - nb_completed);
+    return 1;
+  }
+  auto secs = [] (uint64_t cs) {
+    return (double)cycles::nanoseconds_of(cs) / 1.0e9;
+  };
+  uint64_t idle = (nb_procs * makespan) - std::min(nb_procs * makespan, work);
+  printf("{\"nb_strands\": %lu,\n", strands.size());
+  printf("\"work_cycles\": %lu,\n", work);
+  printf("\"span_cycles\": %lu,\n", span);
+  printf("\"recorded_nb_workers\": %lu,\n", bs.size());
+  printf("\"recorded_makespan_secs\": %.6f,\n", secs(recorded_makespan));
+  printf("\"nb_workers\": %lu,\n", nb_procs);
+  printf("\"makespan_cycles\": %lu,\n", makespan);
+  printf("\"makespan_secs\": %.6f,\n", secs(makespan));
+  printf("\"idle_cycles\": %lu,\n", idle);
+  printf("\"steal_cycles\": %lu,\n", steal_time);
+  printf("\"nb_steals\": %lu,\n", nb_steals);
+  printf("\"nb_failed_steals\": %lu,\n", nb_failed_steals);
+  printf("\"utilization\": %.3f}\n", (makespan == 0) ? 0.0 : (double)work / (double)(nb_procs * makespan));
+  return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <numeric>
+#include <vector>
+
+#include <taskparts/logging.hpp>
+#include <taskparts/cmdline.hpp>
+
+/* Converts a trace stream (see TASKPARTS_LOGGING_STREAM in
+ * logging.hpp) to the JSON format of the Chrome and Perfetto trace
+ * viewers, e.g.:
+ *
+ *   trace2json.opt -input trace.bin -output trace.json
+ */
+int main() {
+  auto input = taskparts::cmdline::parse_string("input");
+  auto output = taskparts::cmdline::parse_or_default_string("output", "trace.json");
+  std::vector<taskparts::buffer_type> bs;
+  size_t nb_dropped;
+  if (! taskparts::read_trace_stream(input, bs, nb_dropped)) {
+    fprintf(stderr, "%s is not a trace stream\n", input.c_str());
+    return 1;
+  }
+  taskparts::logging_base<true>::output_json(bs, nb_dropped, output);
+  printf("%s: %lu events, %lu dropped\n", output.c_str(),
+	 std::accumulate(bs.begin(), bs.end(), (size_t)0, [] (size_t n, const auto& b) {
+	   return n + b.size();
+	 }), nb_dropped);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <taskparts/nativeforkjoin.hpp>
+#include <taskparts/taskgraph.hpp>
+
+// Minimum edit distance between strings a and b by dynamic
+// programming over the (|a|+1) x (|b|+1) table d, in blocks of
+// block x block cells. Block (i, j) depends on blocks (i-1, j) and
+// (i, j-1), and so the blocks on each anti-diagonal can run in
+// parallel.
+
+using editdist_table = std::vector<std::vector<int>>;
+
+inline
+auto editdist_block(const std::vector<char>& a, const std::vector<char>& b,
+		    editdist_table& d, size_t block, size_t bi, size_t bj) {
+  auto ilo = 1 + bi * block;
+  auto ihi = std::min(a.size() + 1, ilo + block);
+  auto jlo = 1 + bj * block;
+  auto jhi = std::min(b.size() + 1, jlo + block);
+  for (auto i = ilo; i < ihi; i++) {
+    for (auto j = jlo; j < jhi; j++) {
+      auto c = (a[i - 1] == b[j - 1]) ? 0 : 1;
+      d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + c});
+    }
+  }
+}
+
+inline
+auto editdist_init(const std::vector<char>& a, const std::vector<char>& b) -> editdist_table {
+  editdist_table d(a.size() + 1, std::vector<int>(b.size() + 1, 0));
+  for (size_t i = 0; i <= a.size(); i++) {
+    d[i][0] = i;
+  }
+  for (size_t j = 0; j <= b.size(); j++) {
+    d[0][j] = j;
+  }
+  return d;
+}
+
+inline
+auto editdist_nb_blocks(size_t n, size_t block) -> size_t {
+  return (n + block - 1) / block;
+}
+
+inline
+auto editdist_serial(const std::vector<char>& a, const std::vector<char>& b) -> int {
+  auto d = editdist_init(a, b);
+  editdist_block(a, b, d, std::max(a.size(), b.size()), 0, 0);
+  return d[a.size()][b.size()];
+}
+
+template <typename Body, typename Scheduler>
+auto editdist_parallel_for(size_t lo, size_t hi, const Body& body, Scheduler sched) -> void {
+  if ((hi - lo) <= 1) {
+    if (lo < hi) {
+      body(lo);
+    }
+    return;
+  }
+  auto mid = (lo + hi) / 2;
+  taskparts::fork2join([&] {
+    editdist_parallel_for(lo, mid, body, sched);
+  }, [&] {
+    editdist_parallel_for(mid, hi, body, sched);
+  }, sched);
+}
+
+// one parallel phase per anti-diagonal of blocks, with a barrier
+// between consecutive phases
+template <typename Scheduler>
+auto editdist_phases(const std::vector<char>& a, const std::vector<char>& b,
+		     size_t block, Scheduler sched) -> int {
+  auto d = editdist_init(a, b);
+  auto nbi = editdist_nb_blocks(a.size(), block);
+  auto nbj = editdist_nb_blocks(b.size(), block);
+  for (size_t k = 0; k + 1 < nbi + nbj; k++) {
+    auto lo = (k < nbj) ? 0 : k - nbj + 1;
+    auto hi = std::min(k + 1, nbi);
+    editdist_parallel_for(lo, hi, [&] (size_t bi) {
+      editdist_block(a, b, d, block, bi, k - bi);
+    }, sched);
+  }
+  return d[a.size()][b.size()];
+}
+
+// one node per block, with an edge to each of the two blocks that
+// depend on it
+template <typename Scheduler>
+auto editdist_taskgraph(const std::vector<char>& a, const std::vector<char>& b,
+			size_t block, Scheduler sched) -> int {
+  auto d = editdist_init(a, b);
+  auto nbi = editdist_nb_blocks(a.size(), block);
+  auto nbj = editdist_nb_blocks(b.size(), block);
+  taskparts::task_graph<Scheduler> g;
+  for (size_t bi = 0; bi < nbi; bi++) {
+    for (size_t bj = 0; bj < nbj; bj++) {
+      g.add_node([&, bi, bj] {
+	editdist_block(a, b, d, block, bi, bj);
+      });
+    }
+  }
+  for (size_t bi = 0; bi < nbi; bi++) {
+    for (size_t bj = 0; bj < nbj; bj++) {
+      if (bi + 1 < nbi) {
+	g.add_edge(bi * nbj + bj, (bi + 1) * nbj + bj);
+      }
+      if (bj + 1 < nbj) {
+	g.add_edge(bi * nbj + bj, bi * nbj + bj + 1);
+      }
+    }
+  }
+  g.run();
+  return d[a.size()][b.size()];
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <taskparts/fiber.hpp>
+#include <taskparts/fanin.hpp>
+
+// Spawns the fibers lo, ..., hi-1 by binary splitting, each of which
+// has an edge to the join fiber j.
+template <typename Scheduler=taskparts::minimal_scheduler<>>
+class fanin_par : public taskparts::fiber<Scheduler> {
+public:
+
+  size_t lo, hi;
+
+  taskparts::fiber<Scheduler>* j;
+
+  fanin_par(size_t lo, size_t hi, taskparts::fiber<Scheduler>* j, Scheduler sched=Scheduler())
+    : taskparts::fiber<Scheduler>(), lo(lo), hi(hi), j(j) { }
+
+  auto run() -> taskparts::fiber_status_type {
+    assert(lo < hi);
+    lo++;
+    if (lo == hi) {
+      return taskparts::fiber_status_finish;
+    }
+    auto mid = (lo + hi) / 2;
+    if (lo < mid) {
+      auto f1 = new fanin_par(lo, mid, j);
+      taskparts::fiber<Scheduler>::add_edge(f1, j);
+      f1->release();
+    }
+    auto f2 = new fanin_par(mid, hi, j);
+    taskparts::fiber<Scheduler>::add_edge(f2, j);
+    f2->release();
+    return taskparts::fiber_status_finish;
+  }
+
+};
+
+// A join fiber of fan-in degree nb, whose in-counter is a plain atomic
+// counter (Join_fiber=fiber) or a SNZI tree (Join_fiber=fanin_fiber).
+template <template <typename> typename Join_fiber,
+	  typename Scheduler=taskparts::minimal_scheduler<>>
+class fanin_join : public Join_fiber<Scheduler> {
+public:
+
+  using trampoline_type = enum trampoline_enum { entry, exit };
+
+  trampoline_type trampoline = entry;
+
+  size_t nb;
+
+  fanin_join(size_t nb, Scheduler sched=Scheduler())
+    : Join_fiber<Scheduler>(), nb(nb) { }
+
+  auto run() -> taskparts::fiber_status_type {
+    switch (trampoline) {
+    case entry: {
+      trampoline = exit;
+      if (nb == 0) {
+	break;
+      }
+      auto f = new fanin_par(0, nb, this);
+      taskparts::fiber<Scheduler>::add_edge(f, this);
+      f->release();
+      return taskparts::fiber_status_pause;
+    }
+    case exit: {
+      break;
+    }
+    }
+    return taskparts::fiber_status_finish;
+  }
+
+};
+
+template <typename Scheduler>
+using fanin_snzi_fiber = taskparts::fanin_fiber<Scheduler>;
@@ -44,3 +44,52 @@ public:
   }
   
 };
+
+// Same as above, but with static dispatch (see crtp_fiber)
+template <typename Scheduler=taskparts::minimal_scheduler<>>
+class fib_crtpfiber final : public taskparts::crtp_fiber<fib_crtpfiber<Scheduler>, Scheduler> {
+public:
+
+  using trampoline_type = enum trampoline_enum { entry, exit };
+
+  trampoline_type trampoline = entry;
+
+  int64_t n; int64_t* dst;
+  int64_t d1, d2;
+
+  fib_crtpfiber(int64_t n, int64_t* dst, Scheduler sched=Scheduler())
+    : taskparts::crtp_fiber<fib_crtpfiber<Scheduler>, Scheduler>(), n(n), dst(dst) { }
+
+  auto run() -> taskparts::fiber_status_type {
+    switch (trampoline) {
+    case entry: {
+      if (n <= fib_serial_threshold) {
+        *dst = fib_serial(n);
+        break;
+      }
+      auto f1 = new fib_crtpfiber(n-1, &d1);
+      auto f2 = new fib_crtpfiber(n-2, &d2);
+      taskparts::fiber<Scheduler>::add_edge(f1, this);
+      taskparts::fiber<Scheduler>::add_edge(f2, this);
+      f1->release();
+      f2->release();
+      trampoline = exit;
+      return taskparts::fiber_status_pause;
+    }
+    case exit: {
+      *dst = d1 + d2;
+      break;
+    }
+    }
+    return taskparts::fiber_status_finish;
+  }
+
+};
+
+// number of fibers created by fib_manualfiber(n) (or fib_crtpfiber(n))
+auto fib_manualfiber_nb_fibers(int64_t n) -> int64_t {
+  if (n <= fib_serial_threshold) {
+    return 1;
+  }
+  return 1 + fib_manualfiber_nb_fibers(n - 1) + fib_manualfiber_nb_fibers(n - 2);
+}
@@ -4,6 +4,8 @@
 #include <memory>
 #include <assert.h>
 #include <array>
+#include <algorithm>
+#include <limits>
 
 #include "perworker.hpp"
 #include "fixedcapacity.hpp"
@@ -13,8 +15,12 @@
 namespace taskparts {
 
 // Deque from Arora, Blumofe, and Plaxton (SPAA, 1998).
-template <typename Fiber>
+template <typename Fiber, typename Layout>
 struct abp {
+  
+  static constexpr
+  bool reports_surplus = false;
+  
   using qidx = unsigned int;
   using tag_t = unsigned int;
   
@@ -27,13 +33,14 @@ struct abp {
   };
   
   // align to avoid false sharing
-  struct alignas(64) padded_fiber {
+  struct alignas(Layout::slot_align_szb) padded_fiber {
     std::atomic<Fiber*> f;
   };
   
   static constexpr int q_size = 10000;
-  std::atomic<qidx> bot;
-  std::atomic<age_t> age;
+  alignas(Layout::index_align_szb) std::atomic<qidx> bot;
+  alignas(Layout::index_align_szb) std::atomic<age_t> age;
+  alignas(std::max(Layout::index_align_szb, alignof(padded_fiber)))
   std::array<padded_fiber, q_size> deq;
   
   abp() : bot(0), age(age_t{0, 0}) {}
@@ -45,9 +52,14 @@ struct abp {
   auto empty() -> bool {
     return size() == 0;
   }
+
+  auto footprint_szb() -> size_t {
+    return sizeof(*this);
+  }
   
   auto push(Fiber* f) -> deque_surplus_result_type {
     auto local_bot = bot.load(std::memory_order_relaxed);      // atomic load
+    auto was_empty = (local_bot <= age.load(std::memory_order_relaxed).top);
     deq[local_bot].f.store(f, std::memory_order_relaxed);  // shared store
     local_bot += 1;
     if (local_bot == q_size) {
@@ -55,7 +67,7 @@ struct abp {
     }
     bot.store(local_bot, std::memory_order_relaxed);  // shared store
     std::atomic_thread_fence(std::memory_order_seq_cst);
-    return deque_surplus_unknown;
+    return was_empty ? deque_surplus_up : deque_surplus_stable;
   }
   
   auto pop() -> std::pair<Fiber*, deque_surplus_result_type> {
@@ -101,6 +113,192 @@ struct abp {
     }
     return std::make_pair(result, deque_surplus_unknown);
   }
+
+  // Steals up to half of the items, but no more than max, writing
+  // them oldest first to dst. Because the owner may pop without
+  // synchronizing with thieves, each item is claimed by a separate
+  // steal.
+  auto steal_batch(Fiber** dst, size_t max) -> std::pair<size_t, deque_surplus_result_type> {
+    size_t n = std::min((size_t)std::max(size() / 2, 1u), max);
+    size_t i = 0;
+    for (; i < n; i++) {
+      auto f = steal().first;
+      if (f == nullptr) {
+        break;
+      }
+      dst[i] = f;
+    }
+    return std::make_pair(i, deque_surplus_unknown);
+  }
+  
+};
+
+/*---------------------------------------------------------------------*/
+/* Growable variant of the ABP deque
+ *
+ * Same protocol as abp, except that items are stored in a circular
+ * array, which doubles in capacity when the owner pushes onto a full
+ * array, as in chaselev::circular_array::grow. A thief that loaded the previous
+ * array may still read from it, and so retired arrays are kept until
+ * the deque is destroyed; their total size is bounded by the size of
+ * the current array.
+ */
+
+template <typename Fiber, typename Layout>
+struct abp_growable {
+  
+  static constexpr
+  bool reports_surplus = false;
+  
+  using qidx = unsigned int;
+  using tag_t = unsigned int;
+  
+  struct alignas(int64_t) age_t {
+    tag_t tag;
+    qidx top;
+  };
+  
+  struct alignas(Layout::slot_align_szb) padded_fiber {
+    std::atomic<Fiber*> f;
+  };
+
+  class array_type {
+  private:
+
+    std::unique_ptr<padded_fiber[]> items;
+
+    std::unique_ptr<array_type> previous;
+
+  public:
+
+    qidx capacity;
+
+    array_type(qidx capacity)
+      : items(new padded_fiber[capacity]), capacity(capacity) { }
+
+    // capacity is a power of two
+    auto get(qidx i) -> Fiber* {
+      return items[i & (capacity - 1)].f.load(std::memory_order_relaxed);
+    }
+
+    auto put(qidx i, Fiber* f) {
+      items[i & (capacity - 1)].f.store(f, std::memory_order_relaxed);
+    }
+
+    auto footprint_szb() -> size_t {
+      auto szb = sizeof(*this) + capacity * sizeof(padded_fiber);
+      return szb + (previous ? previous->footprint_szb() : 0);
+    }
+
+    auto grow(qidx top, qidx bot) -> array_type* {
+      if (capacity > (std::numeric_limits<qidx>::max() / 2)) {
+        taskparts_die("internal error: scheduler queue overflow\n");
+      }
+      auto a = new array_type(2 * capacity);
+      a->previous.reset(this);
+      for (qidx i = top; i != bot; i++) {
+        a->put(i, get(i));
+      }
+      return a;
+    }
+    
+  };
+
+  static constexpr
+  qidx initial_capacity = 64;
+  
+  alignas(Layout::index_align_szb) std::atomic<qidx> bot;
+  alignas(Layout::index_align_szb) std::atomic<age_t> age;
+  alignas(Layout::index_align_szb) std::atomic<array_type*> deq;
+  
+  abp_growable()
+    : bot(0), age(age_t{0, 0}), deq(new array_type(initial_capacity)) { }
+
+  ~abp_growable() {
+    delete deq.load(std::memory_order_relaxed);
+  }
+  
+  auto size() -> unsigned int {
+    return bot.load() - age.load().top;
+  }
+  
+  auto empty() -> bool {
+    return size() == 0;
+  }
+
+  auto footprint_szb() -> size_t {
+    return sizeof(*this) + deq.load()->footprint_szb();
+  }
+  
+  auto push(Fiber* f) -> deque_surplus_result_type {
+    auto local_bot = bot.load(std::memory_order_relaxed);
+    auto a = deq.load(std::memory_order_relaxed);
+    auto top = age.load(std::memory_order_relaxed).top;
+    if (local_bot - top == a->capacity) {
+      a = a->grow(top, local_bot);
+      deq.store(a, std::memory_order_release);
+    }
+    a->put(local_bot, f);
+    bot.store(local_bot + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return (local_bot <= top) ? deque_surplus_up : deque_surplus_stable;
+  }
+  
+  auto pop() -> std::pair<Fiber*, deque_surplus_result_type> {
+    Fiber* result = nullptr;
+    auto local_bot = bot.load(std::memory_order_relaxed);
+    if (local_bot != 0) {
+      local_bot--;
+      bot.store(local_bot, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto f = deq.load(std::memory_order_relaxed)->get(local_bot);
+      auto old_age = age.load(std::memory_order_relaxed);
+      if (local_bot > old_age.top) {
+        result = f;
+      } else {
+        bot.store(0, std::memory_order_relaxed);
+        auto new_age = age_t{old_age.tag + 1, 0};
+        if ((local_bot == old_age.top) &&
+            age.compare_exchange_strong(old_age, new_age)) {
+          result = f;
+        } else {
+          age.store(new_age, std::memory_order_relaxed);
+          result = nullptr;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+    return std::make_pair(result, deque_surplus_unknown);
+  }
+  
+  auto steal() -> std::pair<Fiber*, deque_surplus_result_type> {
+    Fiber* result = nullptr;
+    auto old_age = age.load(std::memory_order_acquire);
+    auto local_bot = bot.load(std::memory_order_acquire);
+    if (local_bot > old_age.top) {
+      auto f = deq.load(std::memory_order_acquire)->get(old_age.top);
+      auto new_age = old_age;
+      new_age.top = new_age.top + 1;
+      if (age.compare_exchange_strong(old_age, new_age)) {
+        result = f;
+      }
+    }
+    return std::make_pair(result, deque_surplus_unknown);
+  }
+
+  // See abp::steal_batch().
+  auto steal_batch(Fiber** dst, size_t max) -> std::pair<size_t, deque_surplus_result_type> {
+    size_t n = std::min((size_t)std::max(size() / 2, 1u), max);
+    size_t i = 0;
+    for (; i < n; i++) {
+      auto f = steal().first;
+      if (f == nullptr) {
+        break;
+      }
+      dst[i] = f;
+    }
+    return std::make_pair(i, deque_surplus_unknown);
+  }
   
 };
 
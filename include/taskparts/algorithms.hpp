@@ -0,0 +1,360 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+
+#include "hash.hpp"
+#include "oracleguided.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Parallel algorithms */
+
+/* Parallel primitives in the style of parlaylib, written against
+ * fork2join() and granularity-controlled by spguard() (see
+ * oracleguided.hpp), so that benchmarks need not depend on parlaylib.
+ * Each call site of a primitive gets an estimator of its own. The
+ * primitives take index ranges [lo, hi) and functions of indices,
+ * like parallel_for(), and write to random-access outputs (e.g.,
+ * pointers or vector iterators), which the caller allocates; only
+ * the temporaries of the primitives themselves are allocated here.
+ *
+ * The blocked primitives (scan, pack, histogram, and sample_sort)
+ * process blocks of algorithms_block_sz items.
+ */
+
+static constexpr
+size_t algorithms_block_sz = 2048;
+
+template <typename T>
+auto algorithms_tmp_array(size_t n) -> std::unique_ptr<T[]> {
+  return std::unique_ptr<T[]>(new T[n]);
+}
+
+static inline
+auto algorithms_nb_blocks(size_t n, size_t block_sz=algorithms_block_sz) -> size_t {
+  return (n + block_sz - 1) / block_sz;
+}
+
+/*---------------------------------------------------------------------*/
+/* Tabulate and reduce */
+
+// out[i] = f(i), for each i in [lo, hi)
+template <typename F, typename Output, typename Scheduler=minimal_scheduler<>>
+auto tabulate(size_t lo, size_t hi, const F& f, Output out,
+	      Scheduler sched=Scheduler()) -> void {
+  parallel_for(lo, hi, [&] (size_t i) {
+    out[i] = f(i);
+  }, dflt_parallel_for_cost_fn, sched);
+}
+
+// returns combine(...combine(combine(id, lift(lo)), lift(lo+1))...,
+// lift(hi-1)), where combine must be associative and id must be its
+// identity
+template <typename T, typename Combine, typename Lift, typename Scheduler=minimal_scheduler<>>
+auto reduce(size_t lo, size_t hi, T id, const Combine& combine, const Lift& lift,
+	    Scheduler sched=Scheduler()) -> T {
+  T r = id;
+  spguard([&] { return hi - lo; }, [&] {
+    if ((hi - lo) <= 1) {
+      r = (lo < hi) ? combine(id, lift(lo)) : id;
+      return;
+    }
+    auto mid = lo + (hi - lo) / 2;
+    T r1 = id;
+    T r2 = id;
+    ogfork2join([&] {
+      r1 = reduce(lo, mid, id, combine, lift, sched);
+    }, [&] {
+      r2 = reduce(mid, hi, id, combine, lift, sched);
+    }, sched);
+    r = combine(r1, r2);
+  }, [&] {
+    T acc = id;
+    for (auto i = lo; i < hi; i++) {
+      acc = combine(acc, lift(i));
+    }
+    r = acc;
+  });
+  return r;
+}
+
+/*---------------------------------------------------------------------*/
+/* Scan */
+
+// Exclusive scan: writes out[i] = combine(id, lift(lo), ...,
+// lift(i-1)) for each i in [lo, hi), and returns the combination of
+// all of lift(lo), ..., lift(hi-1). lift may be called twice per index.
+template <typename T, typename Combine, typename Lift, typename Output,
+	  typename Scheduler=minimal_scheduler<>>
+auto scan(size_t lo, size_t hi, T id, const Combine& combine, const Lift& lift, Output out,
+	  Scheduler sched=Scheduler()) -> T {
+  auto n = hi - lo;
+  auto nb_blocks = algorithms_nb_blocks(n);
+  auto block_lo = [&] (size_t b) { return lo + b * algorithms_block_sz; };
+  auto block_hi = [&] (size_t b) { return std::min(hi, lo + (b + 1) * algorithms_block_sz); };
+  if (nb_blocks <= 1) {
+    T acc = id;
+    for (auto i = lo; i < hi; i++) {
+      out[i] = acc;
+      acc = combine(acc, lift(i));
+    }
+    return acc;
+  }
+  auto sums = algorithms_tmp_array<T>(nb_blocks);
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    T acc = id;
+    for (auto i = block_lo(b); i < block_hi(b); i++) {
+      acc = combine(acc, lift(i));
+    }
+    sums[b] = acc;
+  }, dflt_parallel_for_cost_fn, sched);
+  T total = id;
+  for (size_t b = 0; b < nb_blocks; b++) {
+    auto s = sums[b];
+    sums[b] = total;
+    total = combine(total, s);
+  }
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    T acc = sums[b];
+    for (auto i = block_lo(b); i < block_hi(b); i++) {
+      out[i] = acc;
+      acc = combine(acc, lift(i));
+    }
+  }, dflt_parallel_for_cost_fn, sched);
+  return total;
+}
+
+/*---------------------------------------------------------------------*/
+/* Pack and filter */
+
+// writes lift(i), for each i in [lo, hi) such that flag(i), to out[0],
+// out[1], ... in order of i, and returns the number of items written
+template <typename Flag, typename Lift, typename Output, typename Scheduler=minimal_scheduler<>>
+auto pack(size_t lo, size_t hi, const Flag& flag, const Lift& lift, Output out,
+	  Scheduler sched=Scheduler()) -> size_t {
+  auto n = hi - lo;
+  auto nb_blocks = algorithms_nb_blocks(n);
+  if (nb_blocks == 0) {
+    return 0;
+  }
+  auto block_lo = [&] (size_t b) { return lo + b * algorithms_block_sz; };
+  auto block_hi = [&] (size_t b) { return std::min(hi, lo + (b + 1) * algorithms_block_sz); };
+  auto offsets = algorithms_tmp_array<size_t>(nb_blocks);
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    size_t c = 0;
+    for (auto i = block_lo(b); i < block_hi(b); i++) {
+      c += flag(i) ? 1 : 0;
+    }
+    offsets[b] = c;
+  }, dflt_parallel_for_cost_fn, sched);
+  size_t total = 0;
+  for (size_t b = 0; b < nb_blocks; b++) {
+    auto c = offsets[b];
+    offsets[b] = total;
+    total += c;
+  }
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    auto k = offsets[b];
+    for (auto i = block_lo(b); i < block_hi(b); i++) {
+      if (flag(i)) {
+	out[k++] = lift(i);
+      }
+    }
+  }, dflt_parallel_for_cost_fn, sched);
+  return total;
+}
+
+// writes the items in[i], for each i in [0, n) such that pred(in[i]),
+// to out[0], out[1], ... in order, and returns the number of items
+// written
+template <typename Input, typename Pred, typename Output, typename Scheduler=minimal_scheduler<>>
+auto filter(Input in, size_t n, const Pred& pred, Output out,
+	    Scheduler sched=Scheduler()) -> size_t {
+  return pack(0, n, [&] (size_t i) { return pred(in[i]); },
+	      [&] (size_t i) { return in[i]; }, out, sched);
+}
+
+/*---------------------------------------------------------------------*/
+/* Histogram */
+
+// counts[k] = the number of i in [lo, hi) such that bucket_of(i) = k,
+// for each k in [0, nb_buckets)
+template <typename Bucket_of, typename Counts, typename Scheduler=minimal_scheduler<>>
+auto histogram(size_t lo, size_t hi, size_t nb_buckets, const Bucket_of& bucket_of, Counts counts,
+	       Scheduler sched=Scheduler()) -> void {
+  auto n = hi - lo;
+  auto nb_blocks = std::min(algorithms_nb_blocks(n), (size_t)(4 * perworker::nb_workers()));
+  if ((nb_blocks <= 1) || ((nb_buckets * nb_blocks) > n)) {
+    // few items per bucket: count by atomic increments
+    auto cs = algorithms_tmp_array<std::atomic<size_t>>(nb_buckets);
+    parallel_for(0, nb_buckets, [&] (size_t k) {
+      cs[k].store(0, std::memory_order_relaxed);
+    }, dflt_parallel_for_cost_fn, sched);
+    parallel_for(lo, hi, [&] (size_t i) {
+      auto k = bucket_of(i);
+      assert(k < nb_buckets);
+      cs[k].fetch_add(1, std::memory_order_relaxed);
+    }, dflt_parallel_for_cost_fn, sched);
+    parallel_for(0, nb_buckets, [&] (size_t k) {
+      counts[k] = cs[k].load(std::memory_order_relaxed);
+    }, dflt_parallel_for_cost_fn, sched);
+    return;
+  }
+  // many items per bucket: count in a private array per block, and then
+  // sum up the arrays
+  auto block_sz = (n + nb_blocks - 1) / nb_blocks;
+  auto cs = algorithms_tmp_array<size_t>(nb_blocks * nb_buckets);
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    auto c = &cs[b * nb_buckets];
+    std::fill(c, c + nb_buckets, 0);
+    auto hi2 = std::min(hi, lo + (b + 1) * block_sz);
+    for (auto i = lo + b * block_sz; i < hi2; i++) {
+      auto k = bucket_of(i);
+      assert(k < nb_buckets);
+      c[k]++;
+    }
+  }, dflt_parallel_for_cost_fn, sched);
+  parallel_for(0, nb_buckets, [&] (size_t k) {
+    size_t c = 0;
+    for (size_t b = 0; b < nb_blocks; b++) {
+      c += cs[b * nb_buckets + k];
+    }
+    counts[k] = c;
+  }, dflt_parallel_for_cost_fn, sched);
+}
+
+/*---------------------------------------------------------------------*/
+/* Merge */
+
+// Stable merge of the sorted sequences a[0, na) and b[0, nb) into
+// out[0, na+nb): of equal items, those of a come first.
+template <typename Input1, typename Input2, typename Output, typename Less,
+	  typename Scheduler=minimal_scheduler<>>
+auto merge(Input1 a, size_t na, Input2 b, size_t nb, Output out, const Less& less,
+	   Scheduler sched=Scheduler()) -> void {
+  spguard([&] { return na + nb; }, [&] {
+    if ((na + nb) <= 1) {
+      std::merge(a, a + na, b, b + nb, out, less);
+      return;
+    }
+    // the pivot goes to out[ma + mb], between the two halves
+    size_t ma, mb, da = 0, db = 0;
+    if (na >= nb) {
+      // the items of b that are less than the pivot go left
+      ma = na / 2;
+      mb = std::lower_bound(b, b + nb, a[ma], less) - b;
+      out[ma + mb] = a[ma];
+      da = 1;
+    } else {
+      // the items of a that are not greater than the pivot go left
+      mb = nb / 2;
+      ma = std::upper_bound(a, a + na, b[mb], less) - a;
+      out[ma + mb] = b[mb];
+      db = 1;
+    }
+    ogfork2join([&] {
+      merge(a, ma, b, mb, out, less, sched);
+    }, [&] {
+      merge(a + (ma + da), na - ma - da, b + (mb + db), nb - mb - db, out + (ma + mb + 1), less, sched);
+    }, sched);
+  }, [&] {
+    std::merge(a, a + na, b, b + nb, out, less);
+  });
+}
+
+/*---------------------------------------------------------------------*/
+/* Sample sort */
+
+// Sorts xs[0, n) in place. The sort picks about sqrt(n) pivots from an
+// oversampling of xs, distributes the items to the buckets between
+// and at the pivots, and then sorts each bucket sequentially. Items
+// equal to a pivot land in a bucket of their own, which needs no
+// sorting, so that inputs with many duplicates get balanced buckets.
+template <typename Iter, typename Less, typename Scheduler=minimal_scheduler<>>
+auto sample_sort(Iter xs, size_t n, const Less& less,
+		 Scheduler sched=Scheduler()) -> void {
+  using value_type = typename std::iterator_traits<Iter>::value_type;
+  if (n <= (4 * algorithms_block_sz)) {
+    std::sort(xs, xs + n, less);
+    return;
+  }
+  // pick pivots
+  size_t oversampling = 8;
+  size_t nb_pivots = std::max((size_t)1, (size_t)std::sqrt((double)n) / 4);
+  size_t nb_samples = nb_pivots * oversampling;
+  auto samples = algorithms_tmp_array<value_type>(nb_samples);
+  tabulate(0, nb_samples, [&] (size_t i) {
+    return xs[hash(i) % n];
+  }, samples.get(), sched);
+  std::sort(samples.get(), samples.get() + nb_samples, less);
+  auto pivots = algorithms_tmp_array<value_type>(nb_pivots);
+  for (size_t i = 0; i < nb_pivots; i++) {
+    pivots[i] = samples[i * oversampling + oversampling / 2];
+  }
+  // bucket 2k holds the items between pivots k-1 and k, and bucket
+  // 2k+1 the items equal to pivot k
+  size_t nb_buckets = 2 * nb_pivots + 1;
+  auto bucket_of = [&] (const value_type& x) -> size_t {
+    auto k = std::lower_bound(pivots.get(), pivots.get() + nb_pivots, x, less) - pivots.get();
+    if ((k < (int64_t)nb_pivots) && ! less(x, pivots[k])) {
+      return 2 * k + 1;
+    }
+    return 2 * k;
+  };
+  // count the items of each block in each bucket
+  auto nb_blocks = algorithms_nb_blocks(n);
+  auto block_hi = [&] (size_t b) { return std::min(n, (b + 1) * algorithms_block_sz); };
+  auto ids = algorithms_tmp_array<uint32_t>(n);
+  auto counts = algorithms_tmp_array<size_t>(nb_blocks * nb_buckets);
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    auto c = &counts[b * nb_buckets];
+    std::fill(c, c + nb_buckets, 0);
+    for (auto i = b * algorithms_block_sz; i < block_hi(b); i++) {
+      auto k = bucket_of(xs[i]);
+      ids[i] = (uint32_t)k;
+      c[k]++;
+    }
+  }, dflt_parallel_for_cost_fn, sched);
+  // offset of each block in each bucket: an exclusive scan over the
+  // transposed counts, so that offsets[k * nb_blocks + b] is where
+  // block b starts writing in bucket k
+  auto offsets = algorithms_tmp_array<size_t>(nb_buckets * nb_blocks);
+  auto total = scan(0, nb_buckets * nb_blocks, (size_t)0, std::plus<size_t>(), [&] (size_t j) {
+    auto k = j / nb_blocks;
+    auto b = j % nb_blocks;
+    return counts[b * nb_buckets + k];
+  }, offsets.get(), sched);
+  assert(total == n);
+  auto bucket_offsets = algorithms_tmp_array<size_t>(nb_buckets + 1);
+  tabulate(0, nb_buckets, [&] (size_t k) {
+    return offsets[k * nb_blocks];
+  }, bucket_offsets.get(), sched);
+  bucket_offsets[nb_buckets] = total;
+  // distribute the items to their buckets
+  auto tmp = algorithms_tmp_array<value_type>(n);
+  parallel_for(0, nb_blocks, [&] (size_t b) {
+    for (auto i = b * algorithms_block_sz; i < block_hi(b); i++) {
+      tmp[offsets[ids[i] * nb_blocks + b]++] = std::move(xs[i]);
+    }
+  }, dflt_parallel_for_cost_fn, sched);
+  // sort the buckets and copy them back
+  parallel_for(0, nb_buckets, [&] (size_t k) {
+    auto lo = bucket_offsets[k];
+    auto hi = bucket_offsets[k + 1];
+    if ((k % 2) == 0) {
+      std::sort(tmp.get() + lo, tmp.get() + hi, less);
+    }
+    std::move(tmp.get() + lo, tmp.get() + hi, xs + lo);
+  }, [&] (size_t lo, size_t hi) {
+    return bucket_offsets[hi] - bucket_offsets[lo];
+  }, sched);
+}
+
+} // end namespace
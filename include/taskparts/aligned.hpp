@@ -130,6 +130,11 @@ public:
     return _size;
   }
 
+  // number of bytes allocated for the items
+  size_t footprint_szb() const {
+    return sizeof(aligned_item_type) * _size;
+  }
+
   // Iterator
 
   using value_type = Item;
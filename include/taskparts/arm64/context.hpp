@@ -117,16 +117,23 @@ public:
     return (Value)r;
   }
   
+  static constexpr
+  size_t thread_stack_alignb = stack_alignb;
+
+  static constexpr
+  size_t dflt_thread_stack_szb = thread_stack_szb;
+
+  // prepares ctx to run val->enter(val) on the given call stack,
+  // which the caller allocates
   template <class Value>
   static
-  char* spawn(context_pointer ctx, Value val) {
+  char* spawn(context_pointer ctx, Value val, char* stack, size_t stack_szb) {
     Value target;
     if ((target = (Value)_taskparts_ctx_save(ctx))) {
       target->enter(target);
       assert(false);
     }
-    char* stack = (char*)malloc(thread_stack_szb);
-    char* stack_end = &stack[thread_stack_szb];
+    char* stack_end = &stack[stack_szb];
     stack_end -= (size_t)stack_end % stack_alignb;
     void** _ctx = (void**)ctx;
     static constexpr
@@ -53,6 +53,7 @@ auto benchmark_nativeforkjoin(const Benchmark& benchmark,
   initialize_tpalrts();
 #endif
   Bench_logging::initialize();
+  load_granularity_profile();
   Bench_stats::start_collecting();
   // warmup
   auto warmup = [&] {
@@ -73,6 +74,7 @@ auto benchmark_nativeforkjoin(const Benchmark& benchmark,
   auto run = [&] {
     benchmark_setup(sched);
     warmup();
+    reset_workspan_sites();
     for (size_t i = 0; i < repeat; i++) {
       reset([&] {
 	Bench_stats::on_enter_work();
@@ -80,7 +82,13 @@ auto benchmark_nativeforkjoin(const Benchmark& benchmark,
 	Bench_logging::reset();
 	Bench_stats::start_collecting();
       }, false, sched);
+#ifdef TASKPARTS_WORKSPAN
+      workspan_program.report(workspan_run(&workspan_program, [&] {
+        benchmark(sched);
+      }));
+#else
       benchmark(sched);
+#endif
       reset([&] {
 	Bench_stats::on_exit_work();
       }, [&] {
@@ -114,8 +122,11 @@ auto benchmark_nativeforkjoin(const Benchmark& benchmark,
   // serial run
   run();
 #endif
+  Bench_logging::teardown();
   // teardown
   Bench_stats::output_summaries();
+  output_workspan_summary();
+  save_granularity_profile();
   teardown_machine();
 }
 
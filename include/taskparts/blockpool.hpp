@@ -0,0 +1,447 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <assert.h>
+
+#include "perworker.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* System allocator for the block pools */
+
+class malloc_block_allocator {
+public:
+
+  static
+  auto allocate(size_t szb, size_t alignb) -> char* {
+    szb = ((szb + alignb - 1) / alignb) * alignb;
+    return (char*)std::aligned_alloc(alignb, szb);
+  }
+
+  static
+  auto deallocate(char* p, size_t) {
+    free(p);
+  }
+
+};
+
+/*---------------------------------------------------------------------*/
+/* Per-worker pools of fixed-size blocks */
+
+/* A block pool hands out blocks of a fixed size, caching freed blocks
+ * in a free list per worker. Each block records its owner, i.e., the
+ * worker that obtained it from the system allocator. A block freed by
+ * its owner goes to the free list of the owner. A block freed by
+ * another worker goes back to its owner via a lock-free return list,
+ * which the owner drains when its free list runs empty. Both lists
+ * hold at most max_cached blocks; beyond that, freed blocks go back to
+ * the system allocator.
+ *
+ * The owner sits in a small trailer after the payload, so that the
+ * payload handed out by allocate() starts the block and is aligned by
+ * the alignment of the pool (alignb). For a call stack, which grows
+ * down, the trailer is thus at the top of the stack, far from its
+ * guard page.
+ *
+ * A thread that is not a worker (e.g., one that submits work to a
+ * worker pool) gets its blocks straight from the system allocator;
+ * such blocks have no owner and go back to the system allocator
+ * when they are freed.
+ */
+template <typename System=malloc_block_allocator>
+class block_pool {
+private:
+
+  using block_type = struct block_struct {
+    size_t owner;
+    struct block_struct* next;
+  };
+
+  using worker_state_type = struct worker_state_struct {
+    block_type* local;
+    size_t nb_local;
+    std::atomic<block_type*> returned;
+    std::atomic<size_t> nb_returned;
+  };
+
+  perworker::array<worker_state_type> states;
+
+  size_t alignb;
+
+  // offset of the trailer in a block
+  size_t trailer_offset;
+
+  size_t block_szb;
+
+  size_t max_cached;
+
+  static constexpr
+  size_t no_owner = ~((size_t)0);
+
+  static
+  auto my_id_or_no_owner() -> size_t {
+    return perworker::is_worker() ? perworker::my_global_id() : no_owner;
+  }
+
+  auto block_of(void* p) -> block_type* {
+    return (block_type*)((char*)p + trailer_offset);
+  }
+
+  auto payload_of(block_type* b) -> void* {
+    return (char*)b - trailer_offset;
+  }
+
+  auto allocate_block() -> block_type* {
+    auto p = System::allocate(block_szb, alignb);
+    if (p == nullptr) {
+      throw std::bad_alloc();
+    }
+    return block_of(p);
+  }
+
+  auto deallocate_block(block_type* b) {
+    System::deallocate((char*)payload_of(b), block_szb);
+  }
+
+  // takes all the blocks returned by other workers
+  auto drain_returned(worker_state_type& s) {
+    auto b = s.returned.exchange(nullptr);
+    size_t n = 0;
+    while (b != nullptr) {
+      auto next = b->next;
+      if (s.nb_local < max_cached) {
+        b->next = s.local;
+        s.local = b;
+        s.nb_local++;
+      } else {
+        deallocate_block(b);
+      }
+      b = next;
+      n++;
+    }
+    s.nb_returned -= n;
+  }
+
+public:
+
+  // number of bytes that the trailer adds to the payload of a block
+  static constexpr
+  size_t trailer_szb = sizeof(block_type) + alignof(block_type) - 1;
+
+  block_pool(size_t payload_szb, size_t alignb = 16, size_t max_cached = 256)
+    : alignb(alignb), max_cached(max_cached) {
+    auto a = alignof(block_type);
+    trailer_offset = ((payload_szb + a - 1) / a) * a;
+    block_szb = trailer_offset + sizeof(block_type);
+  }
+
+  auto payload_szb() const -> size_t {
+    return trailer_offset;
+  }
+
+  // number of bytes of a block, including its trailer
+  auto block_footprint_szb() const -> size_t {
+    return ((block_szb + alignb - 1) / alignb) * alignb;
+  }
+
+  // worker that obtained the block of p from the system allocator, as
+  // an index across all domains (see perworker::my_global_id())
+  auto owner_of(void* p) -> size_t {
+    return block_of(p)->owner;
+  }
+
+  auto allocate(size_t my_id = my_id_or_no_owner()) -> void* {
+    if (my_id == no_owner) {
+      auto b = allocate_block();
+      b->owner = no_owner;
+      return payload_of(b);
+    }
+    auto& s = states.global(my_id);
+    if ((s.local == nullptr) && (s.returned.load(std::memory_order_relaxed) != nullptr)) {
+      drain_returned(s);
+    }
+    block_type* b = s.local;
+    if (b != nullptr) {
+      s.local = b->next;
+      s.nb_local--;
+    } else {
+      b = allocate_block();
+      b->owner = my_id;
+    }
+    return payload_of(b);
+  }
+
+  auto deallocate(void* p, size_t my_id = my_id_or_no_owner()) {
+    auto b = block_of(p);
+    auto owner = b->owner;
+    if (owner == no_owner) {
+      // nothing to do
+    } else if (owner == my_id) {
+      auto& s = states.global(my_id);
+      if (s.nb_local < max_cached) {
+        b->next = s.local;
+        s.local = b;
+        s.nb_local++;
+        return;
+      }
+    } else {
+      auto& s = states.global(owner);
+      if (s.nb_returned.fetch_add(1) < max_cached) {
+        auto head = s.returned.load();
+        do {
+          b->next = head;
+        } while (! s.returned.compare_exchange_weak(head, b));
+        return;
+      }
+      s.nb_returned--;
+    }
+    deallocate_block(b);
+  }
+
+};
+
+/*---------------------------------------------------------------------*/
+/* Per-worker pools of small blocks carved from slabs */
+
+/* A slab pool hands out blocks of a fixed size, which it carves out of
+ * slabs of slab_szb bytes. Each worker carves blocks from slabs of its
+ * own, and so the owner of a block is recorded once per slab, in a
+ * header at the start of the slab, which is aligned by slab_szb. A
+ * block therefore takes exactly its size, and a free block links to
+ * the next one via its own first word. As in block_pool, a block
+ * freed by its owner goes to the free list of the owner, and a block
+ * freed by another worker goes back to its owner via a lock-free
+ * return list. Threads that are not workers share one more set of
+ * slabs and free list, guarded by a lock.
+ *
+ * Unlike those of block_pool, the lists of a slab pool are unbounded,
+ * and slabs are never freed: a block cannot go back to the system
+ * allocator on its own, and the pool does not track when all the
+ * blocks of a slab are free. The memory of each worker is thus the
+ * high-water mark of the blocks that it allocated, e.g., in a
+ * producer-consumer pattern, that of the producer, even after the
+ * consumer frees them all; the producer reuses it for its later
+ * allocations. Fibers are small, so this costs little next to the
+ * per-block header that bounding would take; the call stacks, which
+ * are large, come from a block_pool instead.
+ */
+template <typename System=malloc_block_allocator>
+class slab_pool {
+private:
+
+  using slab_type = struct slab_struct {
+    size_t owner;
+  };
+
+  using block_type = struct block_struct {
+    struct block_struct* next;
+  };
+
+  using worker_state_type = struct worker_state_struct {
+    block_type* local = nullptr;
+    std::atomic<block_type*> returned{nullptr};
+    // unused part of the current slab
+    char* fresh = nullptr;
+    char* fresh_end = nullptr;
+  };
+
+  perworker::array<worker_state_type> states;
+
+  worker_state_type shared;
+
+  std::mutex shared_lock;
+
+  size_t block_szb;
+
+  size_t first_block_offset;
+
+  size_t slab_szb;
+
+  static constexpr
+  size_t no_owner = ~((size_t)0);
+
+  static
+  auto my_id_or_no_owner() -> size_t {
+    return perworker::is_worker() ? perworker::my_global_id() : no_owner;
+  }
+
+  auto slab_of(void* p) -> slab_type* {
+    return (slab_type*)((uintptr_t)p & ~((uintptr_t)slab_szb - 1));
+  }
+
+  auto allocate_from(worker_state_type& s, size_t owner) -> void* {
+    if ((s.local == nullptr) && (s.returned.load(std::memory_order_relaxed) != nullptr)) {
+      s.local = s.returned.exchange(nullptr);
+    }
+    if (s.local != nullptr) {
+      auto b = s.local;
+      s.local = b->next;
+      return b;
+    }
+    if (s.fresh == s.fresh_end) {
+      auto sl = (slab_type*)System::allocate(slab_szb, slab_szb);
+      if (sl == nullptr) {
+        throw std::bad_alloc();
+      }
+      sl->owner = owner;
+      s.fresh = (char*)sl + first_block_offset;
+      s.fresh_end = s.fresh + ((slab_szb - first_block_offset) / block_szb) * block_szb;
+    }
+    auto p = s.fresh;
+    s.fresh += block_szb;
+    return p;
+  }
+
+public:
+
+  // block_szb must be a multiple of alignb, which must be a power of two
+  slab_pool(size_t block_szb, size_t alignb = 16)
+    : block_szb(block_szb) {
+    assert((block_szb % alignb) == 0);
+    first_block_offset = ((sizeof(slab_type) + alignb - 1) / alignb) * alignb;
+    slab_szb = 64 * 1024;
+    while (slab_szb < first_block_offset + 16 * block_szb) {
+      slab_szb *= 2;
+    }
+  }
+
+  auto block_footprint_szb() const -> size_t {
+    return block_szb;
+  }
+
+  auto allocate(size_t my_id = my_id_or_no_owner()) -> void* {
+    if (my_id == no_owner) {
+      std::lock_guard<std::mutex> lk(shared_lock);
+      return allocate_from(shared, no_owner);
+    }
+    return allocate_from(states.global(my_id), my_id);
+  }
+
+  auto deallocate(void* p, size_t my_id = my_id_or_no_owner()) {
+    auto b = (block_type*)p;
+    auto owner = slab_of(p)->owner;
+    if (owner == no_owner) {
+      std::lock_guard<std::mutex> lk(shared_lock);
+      b->next = shared.local;
+      shared.local = b;
+    } else if (owner == my_id) {
+      auto& s = states.global(my_id);
+      b->next = s.local;
+      s.local = b;
+    } else {
+      auto& s = states.global(owner);
+      auto head = s.returned.load();
+      do {
+        b->next = head;
+      } while (! s.returned.compare_exchange_weak(head, b));
+    }
+  }
+
+};
+
+/*---------------------------------------------------------------------*/
+/* Pools for heap-allocated fibers */
+
+/* Fiber objects are served from per-worker slab pools of a few size
+ * classes (powers of two and three halves thereof, rounded up to the
+ * alignment); larger objects go to the system allocator. The pools can
+ * be disabled with the compiler flag TASKPARTS_DISABLE_FIBER_POOLS.
+ * Blocks are aligned by the cache line, except with the compact layout
+ * of fibers (see fiber.hpp), whose fields need no more than the default
+ * alignment.
+ */
+class fiber_pools {
+public:
+
+  static constexpr
+  size_t nb_size_classes = 13; // 64 bytes ... 4 KB
+
+#ifdef TASKPARTS_USE_COMPACT_FIBER_LAYOUT
+  static constexpr
+  size_t alignb = alignof(std::max_align_t);
+#else
+  static constexpr
+  size_t alignb = TASKPARTS_CACHE_LINE_SZB;
+#endif
+
+  // number of bytes of the blocks of size class c
+  static constexpr
+  auto class_szb(size_t c) -> size_t {
+    auto szb = ((c % 2) == 0) ? ((size_t)64 << (c / 2)) : ((size_t)96 << (c / 2));
+    return ((szb + alignb - 1) / alignb) * alignb;
+  }
+
+  static
+  auto size_class_of(size_t szb) -> size_t {
+    size_t c = 0;
+    while ((c < nb_size_classes) && (szb > class_szb(c))) {
+      c++;
+    }
+    return c;
+  }
+
+  // The pools are never destroyed, because fibers may outlive static
+  // destructors.
+  static
+  auto pool_of(size_t c) -> slab_pool<>& {
+    static slab_pool<>** ps = [] {
+      auto ps = new slab_pool<>*[nb_size_classes];
+      for (size_t c = 0; c < nb_size_classes; c++) {
+        ps[c] = new slab_pool<>(class_szb(c), alignb);
+      }
+      return ps;
+    }();
+    assert(c < nb_size_classes);
+    return *ps[c];
+  }
+
+  // number of bytes taken by a fiber object of szb bytes, including
+  // the rounding of its block
+  static
+  auto footprint_szb(size_t szb) -> size_t {
+#ifndef TASKPARTS_DISABLE_FIBER_POOLS
+    auto c = size_class_of(szb);
+    if (c < nb_size_classes) {
+      return pool_of(c).block_footprint_szb();
+    }
+#endif
+    return ((szb + alignb - 1) / alignb) * alignb;
+  }
+
+  // al is the alignment that the object requires; the pools serve
+  // only objects that need no more than alignb
+  static
+  auto allocate(size_t szb, size_t al = alignb) -> void* {
+#ifndef TASKPARTS_DISABLE_FIBER_POOLS
+    auto c = size_class_of(szb);
+    if ((c < nb_size_classes) && (al <= alignb)) {
+      auto p = pool_of(c).allocate();
+      assert(((uintptr_t)p % al) == 0);
+      return p;
+    }
+#endif
+    return ::operator new(szb, std::align_val_t(std::max(al, alignb)));
+  }
+
+  static
+  auto deallocate(void* p, size_t szb, size_t al = alignb) {
+#ifndef TASKPARTS_DISABLE_FIBER_POOLS
+    auto c = size_class_of(szb);
+    if ((c < nb_size_classes) && (al <= alignb)) {
+      pool_of(c).deallocate(p);
+      return;
+    }
+#endif
+    ::operator delete(p, szb, std::align_val_t(std::max(al, alignb)));
+  }
+
+};
+
+} // end namespace
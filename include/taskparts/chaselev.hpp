@@ -4,6 +4,7 @@
 #include <memory>
 #include <assert.h>
 #include <array>
+#include <algorithm>
 
 #include "perworker.hpp"
 #include "fixedcapacity.hpp"
@@ -19,7 +20,7 @@ namespace taskparts {
  *   https://gist.github.com/Amanieu/7347121
  */
   
-template <typename Fiber>
+template <typename Fiber, typename Layout>
 class chaselev {
 
   using index_type = long;
@@ -27,7 +28,7 @@ class chaselev {
   class circular_array {
   private:
     
-    cache_aligned_array<std::atomic<Fiber*>> items;
+    cache_aligned_array<std::atomic<Fiber*>, Layout::slot_align_szb> items;
     
     std::unique_ptr<circular_array> previous;
 
@@ -47,6 +48,11 @@ class chaselev {
       items[index % size()].store(x, std::memory_order_relaxed);
     }
     
+    auto footprint_szb() -> size_t {
+      auto szb = sizeof(*this) + items.footprint_szb();
+      return szb + (previous ? previous->footprint_szb() : 0);
+    }
+
     auto grow(index_type top, index_type bottom) -> circular_array* {
       circular_array* new_array = new circular_array(size() * 2);
       new_array->previous.reset(this);
@@ -58,11 +64,16 @@ class chaselev {
 
   };
 
-  std::atomic<circular_array*> array;
+  alignas(Layout::index_align_szb) std::atomic<circular_array*> array;
   
-  std::atomic<index_type> top, bottom;
+  alignas(Layout::index_align_szb) std::atomic<index_type> top;
+
+  alignas(Layout::index_align_szb) std::atomic<index_type> bottom;
 
 public:
+
+  static constexpr
+  bool reports_surplus = false;
   
   chaselev()
     : array(new circular_array(64)), top(0), bottom(0) { }
@@ -84,6 +95,10 @@ public:
     return size() == 0;
   }
 
+  auto footprint_szb() -> size_t {
+    return sizeof(*this) + array.load()->footprint_szb();
+  }
+
   auto push(Fiber* x) -> deque_surplus_result_type {
     auto b = bottom.load(std::memory_order_relaxed);
     auto t = top.load(std::memory_order_acquire);
@@ -95,7 +110,7 @@ public:
     a->put(b, x);
     std::atomic_thread_fence(std::memory_order_release);
     bottom.store(b + 1, std::memory_order_relaxed);
-    return deque_surplus_unknown;
+    return (b <= t) ? deque_surplus_up : deque_surplus_stable;
   }
 
   auto pop() -> std::pair<Fiber*, deque_surplus_result_type> {
@@ -133,6 +148,23 @@ public:
     }
     return std::make_pair(x, deque_surplus_unknown);
   }
+
+  // Steals up to half of the items, but no more than max, writing
+  // them oldest first to dst. Because the owner may pop without
+  // synchronizing with thieves, each item is claimed by a separate
+  // steal.
+  auto steal_batch(Fiber** dst, size_t max) -> std::pair<size_t, deque_surplus_result_type> {
+    size_t n = std::min((size_t)std::max(size() / 2, 1l), max);
+    size_t i = 0;
+    for (; i < n; i++) {
+      auto f = steal().first;
+      if (f == nullptr) {
+        break;
+      }
+      dst[i] = f;
+    }
+    return std::make_pair(i, deque_surplus_unknown);
+  }
   
 };
 
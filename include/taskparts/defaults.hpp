@@ -48,7 +48,10 @@ public:
   using counter_id_type = enum counter_id_enum {
     nb_fibers,
     nb_steals,
-#ifdef TASKPARTS_ELASTIC_WORKSTEALING
+    nb_stolen_fibers,
+    nb_steals_l2, nb_steals_l3, nb_steals_numa_node, nb_steals_machine,
+    nb_estimator_refreshes, nb_estimator_cas_failures,
+#if defined(TASKPARTS_ELASTIC_WORKSTEALING) || defined(TASKPARTS_PARK_IDLE_WORKERS)
     nb_sleeps, nb_surplus_transitions,
 #endif
     nb_counters
@@ -56,8 +59,10 @@ public:
 
   static
   auto name_of_counter(counter_id_type id) -> const char* {
-    const char* names [] = { "nb_fibers", "nb_steals",
-#ifdef TASKPARTS_ELASTIC_WORKSTEALING
+    const char* names [] = { "nb_fibers", "nb_steals", "nb_stolen_fibers",
+			     "nb_steals_l2", "nb_steals_l3", "nb_steals_numa_node", "nb_steals_machine",
+			     "nb_estimator_refreshes", "nb_estimator_cas_failures",
+#if defined(TASKPARTS_ELASTIC_WORKSTEALING) || defined(TASKPARTS_PARK_IDLE_WORKERS)
 			     "nb_sleeps", "nb_surplus_transitions"
 #endif
     };
@@ -89,9 +94,11 @@ auto dflt_benchmark_setup = [] (bench_scheduler) { };
 auto dflt_benchmark_teardown = [] (bench_scheduler) { };
 auto dflt_benchmark_reset = [] (bench_scheduler) { };
 
-template<typename F>
+template <template <typename> typename Deque=dflt_deque,
+	  typename Victim_selection=dflt_victim_selection, typename F>
 auto launch(const F& f) {
-  using scheduler_type = minimal_scheduler<>;
+  using scheduler_type = minimal_scheduler<minimal_stats, minimal_logging,
+					   minimal_worker, minimal_interrupt, Deque, Victim_selection>;
   scheduler_type sched;
   auto run = [&] {
     f(sched);
@@ -102,7 +109,8 @@ auto launch(const F& f) {
   fiber<scheduler_type>::add_edge(&f_body, f_term);
   f_body.release();
   f_term->release();
-  using cl = work_stealing<scheduler_type, fiber>;
+  using cl = work_stealing<scheduler_type, fiber, minimal_stats, minimal_logging,
+			   minimal_worker, minimal_interrupt, Deque, Victim_selection>;
   cl::launch();
   teardown_machine();
 }
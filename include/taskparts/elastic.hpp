@@ -34,8 +34,14 @@ using dflt_semaphore = semaphore;
 /*---------------------------------------------------------------------*/
 /* Elastic work stealing (driven by surplus) */
 
+/* The state of each policy is static; schedulers that run side by
+ * side (see pool.hpp) each instantiate the policy with a Tag of their
+ * own, so that they do not share it.
+ */
+
 template <typename Stats, typename Logging, typename Semaphore=dflt_semaphore,
-          size_t max_lg_tree_sz=perworker::default_max_nb_workers_lg>
+          size_t max_lg_tree_sz=perworker::default_max_nb_workers_lg,
+          typename Tag=void>
 class elastic {
 public:
   
@@ -316,6 +322,19 @@ public:
   static constexpr
   bool override_rand_worker = false;
 #endif
+
+  static constexpr
+  bool needs_surplus = true;
+
+  static constexpr
+  bool notify_on_unknown_surplus = false;
+
+  static
+  auto on_termination() { }
+
+  // the sentinel thief polls the injection queue
+  static
+  auto on_inject() { }
   
   static
   auto random_in_range(std::pair<size_t, size_t> r) -> int {
@@ -475,34 +494,35 @@ public:
 
 };
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-int elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::alpha;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+int elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::alpha;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-int elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::beta;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+int elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::beta;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-std::unique_ptr<typename elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::cnode_type[]> elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::tree;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+std::unique_ptr<typename elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::cnode_type[]> elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::tree;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-typename elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::cnode_type* elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::nr;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+typename elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::cnode_type* elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::nr;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-perworker::array<std::vector<typename elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::cnode_type*>> elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::paths;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+perworker::array<std::vector<typename elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::cnode_type*>> elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::paths;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-perworker::array<Semaphore> elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::semaphores;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+perworker::array<Semaphore> elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::semaphores;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-perworker::array<std::atomic_bool> elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::flags;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+perworker::array<std::atomic_bool> elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::flags;
 
-template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz>
-size_t elastic<Stats, Logging, Semaphore, max_lg_tree_sz>::tree_height;
+template <typename Stats, typename Logging, typename Semaphore, size_t max_lg_tree_sz, typename Tag>
+size_t elastic<Stats, Logging, Semaphore, max_lg_tree_sz, Tag>::tree_height;
 
 /*---------------------------------------------------------------------*/
 /* Elastic work stealing (with S3 counter) */
 
-template <typename Stats, typename Logging, typename Semaphore=dflt_semaphore>
+template <typename Stats, typename Logging, typename Semaphore=dflt_semaphore,
+          typename Tag=void>
 class elastic_s3 {
 public:
   
@@ -540,6 +560,19 @@ public:
   static constexpr
   bool override_rand_worker = false;
 
+  static constexpr
+  bool needs_surplus = true;
+
+  static constexpr
+  bool notify_on_unknown_surplus = false;
+
+  static
+  auto on_termination() { }
+
+  // the sentinel thief polls the injection queue
+  static
+  auto on_inject() { }
+
   static
   auto initialize() {
     if (const auto env_p = std::getenv("TASKPARTS_ELASTIC_ALPHA")) {
@@ -684,19 +717,19 @@ public:
   
 };
 
-template <typename Stats, typename Logging, typename Semaphore>
-typename elastic_s3<Stats, Logging, Semaphore>::counter_type elastic_s3<Stats, Logging, Semaphore>::c;
+template <typename Stats, typename Logging, typename Semaphore, typename Tag>
+typename elastic_s3<Stats, Logging, Semaphore, Tag>::counter_type elastic_s3<Stats, Logging, Semaphore, Tag>::c;
 
-template <typename Stats, typename Logging, typename Semaphore>
-perworker::array<std::atomic_bool> elastic_s3<Stats, Logging, Semaphore>::flags;
+template <typename Stats, typename Logging, typename Semaphore, typename Tag>
+perworker::array<std::atomic_bool> elastic_s3<Stats, Logging, Semaphore, Tag>::flags;
 
-template <typename Stats, typename Logging, typename Semaphore>
-perworker::array<Semaphore> elastic_s3<Stats, Logging, Semaphore>::semaphores;
+template <typename Stats, typename Logging, typename Semaphore, typename Tag>
+perworker::array<Semaphore> elastic_s3<Stats, Logging, Semaphore, Tag>::semaphores;
 
-template <typename Stats, typename Logging, typename Semaphore>
-int elastic_s3<Stats, Logging, Semaphore>::alpha;
+template <typename Stats, typename Logging, typename Semaphore, typename Tag>
+int elastic_s3<Stats, Logging, Semaphore, Tag>::alpha;
 
-template <typename Stats, typename Logging, typename Semaphore>
-int elastic_s3<Stats, Logging, Semaphore>::beta;
+template <typename Stats, typename Logging, typename Semaphore, typename Tag>
+int elastic_s3<Stats, Logging, Semaphore, Tag>::beta;
 
 } // end namespace
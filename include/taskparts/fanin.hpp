@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+#include "fiber.hpp"
+#include "hash.hpp"
+#include "snzi.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Fibers with scalable in-counters */
+
+/* A fiber that has many predecessors, e.g., the join fiber of a
+ * parallel loop whose iterations are all fibers, spends much of the
+ * time of its predecessors in contention on its in-counter, because
+ * each of them increments it in add_edge() and decrements it in
+ * release(). A fan-in fiber keeps its in-counter in a SNZI tree (see
+ * snzi.hpp) instead, whose 2^height leaves spread these updates over
+ * distinct cache lines; a leaf propagates a change to its parent only
+ * when its own count moves between zero and nonzero, and so the
+ * root sees only a small fraction of all updates. The edge of each
+ * predecessor goes to the leaf picked by the hash of the address of
+ * the predecessor, so that the increment and the decrement of an edge
+ * land on the same leaf. The initial count of the fiber, which is
+ * released by its creator, goes straight to the root.
+ *
+ * The price is a larger fiber (the tree takes 2^(height+2) cache
+ * lines) and a slower release when there are few predecessors, so
+ * fibers opt in by inheriting from fanin_fiber in the place of
+ * fiber. The in-counter of a fan-in fiber must not be written
+ * directly (e.g., by incounter.store(0)).
+ */
+template <typename Scheduler=minimal_scheduler<>, size_t height=4>
+class fanin_fiber : public fiber<Scheduler> {
+private:
+
+  using tree_type = snzi_fixed_capacity_tree<height>;
+
+  using node_type = typename tree_type::node_type;
+
+  tree_type tree;
+
+  auto node_of(fiber<Scheduler>* src) -> node_type& {
+    if (src == nullptr) {
+      return tree.get_root();
+    }
+    return tree[hash((uint64_t)src) & (((size_t)1 << height) - 1)];
+  }
+
+public:
+
+  fanin_fiber(Scheduler sched=Scheduler()) : fiber<Scheduler>() {
+    fiber<Scheduler>::incounter.store(fiber<Scheduler>::fanin_incounter);
+    tree.get_root().increment();
+  }
+
+  void fanin_increment(fiber<Scheduler>* src) override {
+    node_of(src).increment();
+  }
+
+  bool fanin_decrement(fiber<Scheduler>* src) override {
+    return node_of(src).decrement();
+  }
+
+  bool fanin_is_zero() override {
+    return ! tree.get_root().is_nonzero();
+  }
+
+};
+
+} // end namespace
@@ -6,9 +6,52 @@
 #include "scheduler.hpp"
 #include "aligned.hpp"
 #include "atomic.hpp"
+#include "blockpool.hpp"
 
 namespace taskparts {
   
+/*---------------------------------------------------------------------*/
+/* Layouts of fibers */
+
+/* The padded layout (the default) puts the in-counter and the
+ * out-edge of each fiber in cache lines of their own, so that the
+ * predecessors of a fiber that decrement its in-counter do not
+ * interfere with accesses to the rest of the fiber. The compact
+ * layout packs both words right after the vtable pointer, so that a
+ * small fiber fits in a single cache line, whereas a fiber takes at
+ * least 3 * TASKPARTS_CACHE_LINE_SZB bytes with the padded layout. The
+ * compiler flag TASKPARTS_USE_COMPACT_FIBER_LAYOUT selects the compact
+ * layout.
+ */
+
+class fiber_layout_padded {
+public:
+
+  static constexpr
+  size_t incounter_align_szb = TASKPARTS_CACHE_LINE_SZB;
+
+  static constexpr
+  size_t outedge_align_szb = TASKPARTS_CACHE_LINE_SZB;
+
+};
+
+class fiber_layout_compact {
+public:
+
+  static constexpr
+  size_t incounter_align_szb = alignof(std::atomic<std::size_t>);
+
+  static constexpr
+  size_t outedge_align_szb = alignof(void*);
+
+};
+
+#ifdef TASKPARTS_USE_COMPACT_FIBER_LAYOUT
+using fiber_layout = fiber_layout_compact;
+#else
+using fiber_layout = fiber_layout_padded;
+#endif
+
 /*---------------------------------------------------------------------*/
 /* Fibers */
 
@@ -16,10 +59,10 @@ template <typename Scheduler=minimal_scheduler<>>
 class fiber : public minimal_fiber<Scheduler> {
 public:
 
-  alignas(TASKPARTS_CACHE_LINE_SZB)
+  alignas(fiber_layout::incounter_align_szb)
   std::atomic<std::size_t> incounter;
 
-  alignas(TASKPARTS_CACHE_LINE_SZB)
+  alignas(fiber_layout::outedge_align_szb)
   fiber* outedge;
 
   auto schedule() {
@@ -29,6 +72,33 @@ public:
   fiber(Scheduler _sched=Scheduler())
     : minimal_fiber<Scheduler>(), incounter(1), outedge(nullptr) { }
 
+  // heap-allocated fibers come from per-worker pools (see blockpool.hpp)
+
+  static
+  void* operator new(std::size_t szb) {
+    return fiber_pools::allocate(szb);
+  }
+
+  static
+  void* operator new(std::size_t szb, std::align_val_t al) {
+    return fiber_pools::allocate(szb, (size_t)al);
+  }
+
+  static
+  void* operator new(std::size_t, void* p) {
+    return p;
+  }
+
+  static
+  void operator delete(void* p, std::size_t szb) {
+    fiber_pools::deallocate(p, szb);
+  }
+
+  static
+  void operator delete(void* p, std::size_t szb, std::align_val_t al) {
+    fiber_pools::deallocate(p, szb, (size_t)al);
+  }
+
   virtual
   ~fiber() {
   // later: remove the ifdef after correcting the bootstrapping of tpal programs, e.g., sum_tree
@@ -45,21 +115,64 @@ public:
     return run();
   }
 
+  // A fiber whose in-counter is this value keeps its actual
+  // in-counter elsewhere, and is called through the fanin_* methods
+  // below instead (see fanin.hpp). The value is never written after
+  // construction, so that its cache line stays shared.
+  static constexpr
+  std::size_t fanin_incounter = ~((std::size_t)0);
+
+  virtual
+  void fanin_increment(fiber* src) { }
+
+  // returns true iff the in-counter drops to zero
+  virtual
+  bool fanin_decrement(fiber* src) {
+    return false;
+  }
+
+  virtual
+  bool fanin_is_zero() {
+    return false;
+  }
+
   auto is_ready() -> bool {
-    return incounter.load() == 0;
+    auto c = incounter.load();
+    return (c == 0) || ((c == fanin_incounter) && fanin_is_zero());
   }
 
-  auto release() {
+  // src is the predecessor whose edge is released, if any
+  auto release(fiber* src = nullptr) {
+    if (incounter.load(std::memory_order_relaxed) == fanin_incounter) {
+      if (fanin_decrement(src)) {
+        Scheduler::log_fiber_event(fiber_release, this, src);
+        schedule();
+      }
+      return;
+    }
     if (--incounter == 0) {
+      Scheduler::log_fiber_event(fiber_release, this, src);
       schedule();
     }
   }
 
+  // counts src as one more predecessor of dst, without touching the
+  // out-edge of src (see also dataflow_fiber in taskgraph.hpp)
+  static
+  auto incr_incounter(fiber* src, fiber* dst) {
+    if (dst->incounter.load(std::memory_order_relaxed) == fanin_incounter) {
+      dst->fanin_increment(src);
+      return;
+    }
+    dst->incounter++;
+  }
+
   static
   auto add_edge(fiber* src, fiber* dst) {
     assert(src->outedge == nullptr);
     src->outedge = dst;
-    dst->incounter++;
+    Scheduler::log_fiber_event(fiber_add_edge, src, dst);
+    incr_incounter(src, dst);
   }
 
   virtual
@@ -68,7 +181,7 @@ public:
     auto fo = outedge;
     outedge = nullptr;
     if (fo != nullptr) {
-      fo->release();
+      fo->release(this);
     }
   }
 
@@ -86,6 +199,39 @@ public:
 
 };
 
+/*---------------------------------------------------------------------*/
+/* Fibers with static dispatch */
+
+/* A fiber class Derived that inherits from crtp_fiber<Derived,
+ * Scheduler> is called through two virtual calls per execution in the
+ * worker loop, exec() and finish(), instead of five (exec(), run(),
+ * finish(), notify(), and the destructor), because exec() calls the
+ * run() method of Derived directly and finish() notifies and destroys
+ * the fiber without dispatch.
+ */
+template <typename Derived, typename Scheduler=minimal_scheduler<>>
+class crtp_fiber : public fiber<Scheduler> {
+public:
+
+  crtp_fiber(Scheduler sched=Scheduler()) : fiber<Scheduler>() { }
+
+  fiber_status_type exec() final {
+    return static_cast<Derived*>(this)->Derived::run();
+  }
+
+  void finish() final {
+    fiber<Scheduler>::notify();
+    auto d = static_cast<Derived*>(this);
+    d->Derived::~Derived();
+    if constexpr (alignof(Derived) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      Derived::operator delete(d, sizeof(Derived), std::align_val_t(alignof(Derived)));
+    } else {
+      Derived::operator delete(d, sizeof(Derived));
+    }
+  }
+
+};
+
 /*---------------------------------------------------------------------*/
 /* Reset fibers */
 /* We use reset fibers to reset worker-local and global memory, e.g.,
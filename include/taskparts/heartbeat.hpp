@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "machine.hpp"
+#include "perworker.hpp"
+#include "timing.hpp"
+#include "nativeforkjoin.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Heartbeat parallel loops */
+
+/* Parallel loops by heartbeat scheduling, with software polling in the
+ * place of the interrupts and compiler support of TPAL (see
+ * tpalrts.hpp and benchmark/hbcompilation/sum_array.cpp): a loop runs
+ * its iterations sequentially and, every
+ * TASKPARTS_HEARTBEAT_POLLING_INTERVAL iterations (by default, 64),
+ * polls the clock of its worker. Once a heartbeat, i.e.,
+ * TASKPARTS_KAPPA_USEC microseconds (see get_kappa_cycles()), has
+ * elapsed since the last promotion by this worker, the loop promotes
+ * the rest of its range into a fork2join() of two halves. So the
+ * number of forks, and thus the overhead of parallelism, is bounded by
+ * the number of heartbeats, whatever the cost of each iteration.
+ *
+ * A promotion splits the innermost loop that polls, not the outermost
+ * loop with latent parallelism, as a heartbeat scheduler would.
+ */
+
+auto heartbeat_polling_interval() -> size_t {
+  static size_t d = [] {
+    size_t d = 64;
+    if (const auto env_p = std::getenv("TASKPARTS_HEARTBEAT_POLLING_INTERVAL")) {
+      d = std::max(1, std::stoi(env_p));
+    }
+    return d;
+  }();
+  return d;
+}
+
+// time of the last promotion of each worker
+perworker::array<uint64_t> heartbeat_prev(0);
+
+// returns true iff a heartbeat has elapsed since the last promotion
+// by the calling worker, in which case the caller must promote
+static inline
+auto heartbeat_poll() -> bool {
+  auto& p = heartbeat_prev.mine();
+  auto n = cycles::now();
+  if ((p + get_kappa_cycles()) > n) {
+    return false;
+  }
+  p = n;
+  return true;
+}
+
+template <typename F, typename Scheduler=minimal_scheduler<>>
+auto heartbeat_parallel_for(size_t lo, size_t hi, const F& f,
+			    Scheduler sched=Scheduler()) -> void {
+  auto d = heartbeat_polling_interval();
+  while (lo < hi) {
+    if (((hi - lo) >= 2) && heartbeat_poll()) {
+      auto mid = lo + (hi - lo) / 2;
+      fork2join([&] {
+	heartbeat_parallel_for(lo, mid, f, sched);
+      }, [&] {
+	heartbeat_parallel_for(mid, hi, f, sched);
+      }, sched);
+      return;
+    }
+    auto lo2 = std::min(hi, lo + d);
+    for (auto i = lo; i < lo2; i++) {
+      f(i);
+    }
+    lo = lo2;
+  }
+}
+
+// returns combine(...combine(combine(id, lift(lo)), lift(lo+1))...,
+// lift(hi-1)), where combine must be associative and id must be its
+// identity
+template <typename T, typename Combine, typename Lift, typename Scheduler=minimal_scheduler<>>
+auto heartbeat_reduce(size_t lo, size_t hi, T id,
+		      const Combine& combine, const Lift& lift,
+		      Scheduler sched=Scheduler()) -> T {
+  auto d = heartbeat_polling_interval();
+  T acc = id;
+  while (lo < hi) {
+    if (((hi - lo) >= 2) && heartbeat_poll()) {
+      auto mid = lo + (hi - lo) / 2;
+      T r1, r2;
+      fork2join([&] {
+	r1 = heartbeat_reduce(lo, mid, id, combine, lift, sched);
+      }, [&] {
+	r2 = heartbeat_reduce(mid, hi, id, combine, lift, sched);
+      }, sched);
+      return combine(acc, combine(r1, r2));
+    }
+    auto lo2 = std::min(hi, lo + d);
+    for (auto i = lo; i < lo2; i++) {
+      acc = combine(acc, lift(i));
+    }
+    lo = lo2;
+  }
+  return acc;
+}
+
+// Inclusive scan: writes out[i] = combine(init, lift(lo), ..., lift(i))
+// for each i in [lo, hi), and returns the combination of init and all
+// of lift(lo), ..., lift(hi-1). On a promotion, the left half starts
+// from the running value, whereas the right half starts from id and
+// is then offset by the total of the left half, in a second,
+// heartbeat-parallel pass.
+template <typename T, typename Combine, typename Lift, typename Output,
+	  typename Scheduler=minimal_scheduler<>>
+auto heartbeat_scan(size_t lo, size_t hi, T init, T id,
+		    const Combine& combine, const Lift& lift, Output out,
+		    Scheduler sched=Scheduler()) -> T {
+  auto d = heartbeat_polling_interval();
+  T acc = init;
+  while (lo < hi) {
+    if (((hi - lo) >= 2) && heartbeat_poll()) {
+      auto mid = lo + (hi - lo) / 2;
+      T r1, r2;
+      fork2join([&] {
+	r1 = heartbeat_scan(lo, mid, acc, id, combine, lift, out, sched);
+      }, [&] {
+	r2 = heartbeat_scan(mid, hi, id, id, combine, lift, out, sched);
+      }, sched);
+      heartbeat_parallel_for(mid, hi, [&] (size_t i) {
+	out[i] = combine(r1, out[i]);
+      }, sched);
+      return combine(r1, r2);
+    }
+    auto lo2 = std::min(hi, lo + d);
+    for (auto i = lo; i < lo2; i++) {
+      acc = combine(acc, lift(i));
+      out[i] = acc;
+    }
+    lo = lo2;
+  }
+  return acc;
+}
+
+} // end namespace
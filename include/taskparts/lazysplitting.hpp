@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "fiber.hpp"
+#include "nativeforkjoin.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Lazy binary splitting */
+
+/* Parallel loops that need neither cost functions nor a warm
+ * estimator, unlike the parallel_for() of oracleguided.hpp: a loop
+ * runs its iterations sequentially, in chunks, and, after each chunk,
+ * splits its remaining iterations in two halves (by fork2join()) only
+ * if the deque of its worker is empty, i.e., only if no work is
+ * available to be stolen from this worker. A loop thus creates
+ * parallelism only when thieves may need it, and the grain adapts to
+ * irregular iterations without any profiling (after Tzannes et al.,
+ * "Lazy binary splitting", PPoPP 2010).
+ *
+ * The chunk size, i.e., the number of iterations between two
+ * checks of the deque, is given by the environment variable
+ * TASKPARTS_LAZY_SPLITTING_CHUNK (by default, 32), or by the last
+ * argument of each loop.
+ */
+
+auto lazy_splitting_dflt_chunk() -> size_t {
+  static size_t c = [] {
+    size_t c = 32;
+    if (const auto env_p = std::getenv("TASKPARTS_LAZY_SPLITTING_CHUNK")) {
+      c = std::max(1, std::stoi(env_p));
+    }
+    return c;
+  }();
+  return c;
+}
+
+template <typename Scheduler>
+auto lazy_splitting_should_split(size_t nb_remaining, size_t chunk) -> bool {
+  return (nb_remaining > chunk) && Scheduler::template is_deque_empty<fiber>();
+}
+
+template <typename F, typename Scheduler=minimal_scheduler<>>
+auto lazy_parallel_for(size_t lo, size_t hi, const F& f,
+		       Scheduler sched=Scheduler(),
+		       size_t chunk=lazy_splitting_dflt_chunk()) -> void {
+  while (lo < hi) {
+    auto lo2 = std::min(hi, lo + chunk);
+    for (auto i = lo; i < lo2; i++) {
+      f(i);
+    }
+    lo = lo2;
+    if (lazy_splitting_should_split<Scheduler>(hi - lo, chunk)) {
+      auto mid = lo + (hi - lo) / 2;
+      fork2join([&] {
+	lazy_parallel_for(lo, mid, f, sched, chunk);
+      }, [&] {
+	lazy_parallel_for(mid, hi, f, sched, chunk);
+      }, sched);
+      return;
+    }
+  }
+}
+
+// returns combine(...combine(combine(id, lift(lo)), lift(lo+1))...,
+// lift(hi-1)), where combine must be associative and id must be its
+// identity
+template <typename T, typename Combine, typename Lift, typename Scheduler=minimal_scheduler<>>
+auto lazy_parallel_reduce(size_t lo, size_t hi, T id,
+			  const Combine& combine, const Lift& lift,
+			  Scheduler sched=Scheduler(),
+			  size_t chunk=lazy_splitting_dflt_chunk()) -> T {
+  T acc = id;
+  while (lo < hi) {
+    auto lo2 = std::min(hi, lo + chunk);
+    for (auto i = lo; i < lo2; i++) {
+      acc = combine(acc, lift(i));
+    }
+    lo = lo2;
+    if (lazy_splitting_should_split<Scheduler>(hi - lo, chunk)) {
+      auto mid = lo + (hi - lo) / 2;
+      T r1, r2;
+      fork2join([&] {
+	r1 = lazy_parallel_reduce(lo, mid, id, combine, lift, sched, chunk);
+      }, [&] {
+	r2 = lazy_parallel_reduce(mid, hi, id, combine, lift, sched, chunk);
+      }, sched);
+      return combine(acc, combine(r1, r2));
+    }
+  }
+  return acc;
+}
+
+} // end namespace
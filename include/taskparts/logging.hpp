@@ -1,6 +1,16 @@
 #pragma once
 
-#include <deque>
+#include <vector>
+#include <queue>
+#include <atomic>
+#include <set>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <cstring>
 #include <string>
 #include <cstdlib>
 #include <cstdio>
@@ -8,6 +18,7 @@
 #include <memory>
 
 #include "posix/diagnostics.hpp"
+#include "posix/tracefile.hpp"
 #include "scheduler.hpp" // logging events are defined here
 #include "machine.hpp"
 #include "diagnostics.hpp"
@@ -64,7 +75,16 @@ public:
       size_t prio_child;
       size_t prio_parent;
     } failed_to_sleep;
+    struct fiber_event_struct {
+      void* f;
+      void* g;
+      size_t id;
+    } fiber_event;
   } extra;
+
+  auto is_fiber_event() const -> bool {
+    return (tag >= fiber_create) && (tag <= fiber_exit);
+  }
             
   void print_text(FILE* f) {
     auto ns = cycles::nanoseconds_of(cycles::diff(base_time, cycle_count)) / 1000;
@@ -96,6 +116,19 @@ public:
                 extra.failed_to_sleep.prio_parent);
         break;
       }
+      case fiber_create:
+      case fiber_add_edge:
+      case fiber_release:
+      case fiber_steal:
+      case fiber_resume:
+      case fiber_enter:
+      case fiber_exit: {
+        fprintf(f, "%p \t %p \t %ld",
+                extra.fiber_event.f,
+                extra.fiber_event.g,
+                extra.fiber_event.id);
+        break;
+      }
       default: {
         // nothing to do
       }
@@ -164,6 +197,26 @@ public:
 	print_end();
         break;
       }
+      case fiber_create:
+      case fiber_add_edge:
+      case fiber_release:
+      case fiber_steal:
+      case fiber_resume:
+      case fiber_enter:
+      case fiber_exit: {
+        // fiber fields hold compact fiber ids (see output_json())
+	print_hdr();
+	auto n = name_of(tag);
+	n.erase(n.find_last_not_of(' ') + 1);
+	print_json_string("name", n.c_str());
+	print_json_string("cat", (kind_of(tag) == fibers) ? "FIBER" : "MIGRATION");
+	print_json_string("ph", "i");
+	print_json_string("s", "t");
+	fprintf(f, "\"args\": {\"fiber\": %lu, \"other\": %lu, \"worker\": %lu},",
+		(size_t)extra.fiber_event.f, (size_t)extra.fiber_event.g, extra.fiber_event.id);
+	print_end();
+        break;
+      }
       default: {
         break;
       }
@@ -175,9 +228,490 @@ public:
 uint64_t event_type::base_time;
 
 /*---------------------------------------------------------------------*/
-/* Log buffer */
-  
-using buffer_type = std::deque<event_type>;
+/* Trace ring buffers */
+
+/* Each worker records its events in a ring buffer of its own, which
+ * is allocated once, by initialize(), with room for
+ * TASKPARTS_LOGGING_BUFFER_SZ records (by default, 65536; rounded up
+ * to a power of two). A record takes 32 bytes: the number of cycles
+ * elapsed since the previous record of the same worker, the tag, and a
+ * payload. Only the owner of a ring writes to it, so pushing an event
+ * takes neither a lock nor an allocation. When a ring is full, new
+ * records overwrite the oldest ones, and the timestamps of the records
+ * left are rebuilt backwards from the timestamp of the last record.
+ * When the ring is streamed (see trace streams below), a record in
+ * every trace_sync_period carries its timestamp in full rather than as
+ * a delta, so that timestamps can be rebuilt from there on after the
+ * loss of records.
+ */
+
+class trace_record {
+public:
+
+  // cycles since the previous record, or cycle count if is_absolute
+  uint64_t delta : 56;
+
+  uint64_t tag : 7;
+
+  uint64_t is_absolute : 1;
+
+  union payload_union {
+    program_point_type ppt;
+    size_t child_id;
+    uint32_t words[4];
+    struct fiber_event_struct {
+      void* f;
+      void* g;
+      uint32_t id;
+    } fiber_event;
+  } payload;
+
+  static
+  auto encode(const event_type& e, uint64_t delta) -> trace_record {
+    trace_record r;
+    r.delta = delta;
+    r.tag = e.tag;
+    r.is_absolute = 0;
+    switch (e.tag) {
+      case program_point: {
+        r.payload.ppt = e.extra.ppt;
+        break;
+      }
+      case wake_child: {
+        r.payload.child_id = e.extra.child_id;
+        break;
+      }
+      case enter_sleep: {
+        r.payload.words[0] = (uint32_t)e.extra.enter_sleep.parent_id;
+        r.payload.words[1] = (uint32_t)e.extra.enter_sleep.prio_child;
+        r.payload.words[2] = (uint32_t)e.extra.enter_sleep.prio_parent;
+        break;
+      }
+      case failed_to_sleep: {
+        r.payload.words[0] = (uint32_t)e.extra.failed_to_sleep.parent_id;
+        r.payload.words[1] = (uint32_t)e.extra.failed_to_sleep.busy_child;
+        r.payload.words[2] = (uint32_t)e.extra.failed_to_sleep.prio_child;
+        r.payload.words[3] = (uint32_t)e.extra.failed_to_sleep.prio_parent;
+        break;
+      }
+      case fiber_create:
+      case fiber_add_edge:
+      case fiber_release:
+      case fiber_steal:
+      case fiber_resume:
+      case fiber_enter:
+      case fiber_exit: {
+        r.payload.fiber_event.f = e.extra.fiber_event.f;
+        r.payload.fiber_event.g = e.extra.fiber_event.g;
+        r.payload.fiber_event.id = (uint32_t)e.extra.fiber_event.id;
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    return r;
+  }
+
+  auto decode(uint64_t cycle_count, size_t worker_id) const -> event_type {
+    event_type e((event_tag_type)tag);
+    e.cycle_count = cycle_count;
+    e.worker_id = worker_id;
+    switch (e.tag) {
+      case program_point: {
+        e.extra.ppt = payload.ppt;
+        break;
+      }
+      case wake_child: {
+        e.extra.child_id = payload.child_id;
+        break;
+      }
+      case enter_sleep: {
+        e.extra.enter_sleep.parent_id = payload.words[0];
+        e.extra.enter_sleep.prio_child = payload.words[1];
+        e.extra.enter_sleep.prio_parent = payload.words[2];
+        break;
+      }
+      case failed_to_sleep: {
+        e.extra.failed_to_sleep.parent_id = payload.words[0];
+        e.extra.failed_to_sleep.busy_child = payload.words[1];
+        e.extra.failed_to_sleep.prio_child = payload.words[2];
+        e.extra.failed_to_sleep.prio_parent = payload.words[3];
+        break;
+      }
+      case fiber_create:
+      case fiber_add_edge:
+      case fiber_release:
+      case fiber_steal:
+      case fiber_resume:
+      case fiber_enter:
+      case fiber_exit: {
+        e.extra.fiber_event.f = payload.fiber_event.f;
+        e.extra.fiber_event.g = payload.fiber_event.g;
+        e.extra.fiber_event.id = payload.fiber_event.id;
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    return e;
+  }
+
+};
+
+static_assert(sizeof(trace_record) == 32);
+static_assert(nb_events <= 128);
+
+static constexpr
+uint64_t trace_sync_period = 1024;
+
+auto logging_buffer_sz() -> size_t {
+  static size_t sz = [] {
+    size_t sz = 1 << 16;
+    if (const auto env_p = std::getenv("TASKPARTS_LOGGING_BUFFER_SZ")) {
+      sz = std::max(1, std::stoi(env_p));
+    }
+    size_t p = 1;
+    while (p < sz) {
+      p *= 2;
+    }
+    return p;
+  }();
+  return sz;
+}
+
+class trace_ring {
+private:
+
+  std::unique_ptr<trace_record[]> records;
+
+  size_t mask = 0;
+
+  // number of records pushed since the last clear()
+  std::atomic<uint64_t> head;
+
+  // cycle count of the last record
+  uint64_t last = 0;
+
+  // if streaming, records whose index is a multiple of sync_mask + 1
+  // are absolute
+  bool streaming = false;
+
+  uint64_t sync_mask = 0;
+
+public:
+
+  trace_ring() : head(0) { }
+
+  auto allocate(size_t capacity) {
+    if (records) {
+      return;
+    }
+    records.reset(new trace_record[capacity]);
+    mask = capacity - 1;
+  }
+
+  auto enable_streaming() {
+    streaming = true;
+    sync_mask = std::min(trace_sync_period, std::max((uint64_t)1, (mask + 1) / 2)) - 1;
+  }
+
+  auto capacity() const -> size_t {
+    return mask + 1;
+  }
+
+  auto get_head() const -> uint64_t {
+    return head.load(std::memory_order_acquire);
+  }
+
+  // copies the records of indices [lo, hi), which may be torn if the
+  // owner has overwritten them in the meantime
+  auto copy(uint64_t lo, uint64_t hi, trace_record* dst) const {
+    for (auto i = lo; i < hi; i++) {
+      dst[i - lo] = records[i & mask];
+    }
+  }
+
+  auto clear(uint64_t t) {
+    head.store(0);
+    last = t;
+  }
+
+  auto push(const event_type& e) {
+    auto h = head.load(std::memory_order_relaxed);
+    auto t = std::max(e.cycle_count, last);
+    auto& r = records[h & mask];
+    r = trace_record::encode(e, t - last);
+    if (streaming && ((h & sync_mask) == 0)) {
+      r.delta = t;
+      r.is_absolute = 1;
+    }
+    last = t;
+    head.store(h + 1, std::memory_order_release);
+  }
+
+  auto size() const -> size_t {
+    return std::min((size_t)head.load(std::memory_order_acquire), mask + 1);
+  }
+
+  auto nb_dropped() const -> size_t {
+    return head.load(std::memory_order_acquire) - size();
+  }
+
+  // appends the events of the ring to dst, oldest first
+  auto decode(size_t worker_id, std::vector<event_type>& dst) const {
+    auto h = head.load(std::memory_order_acquire);
+    auto n = size();
+    auto b = dst.size();
+    dst.resize(b + n);
+    auto t = last;
+    for (size_t i = 0; i < n; i++) {
+      auto& r = records[(h - 1 - i) & mask];
+      dst[b + n - 1 - i] = r.decode(t, worker_id);
+      t -= r.delta;
+    }
+  }
+
+};
+
+using buffer_type = std::vector<event_type>;
+
+/*---------------------------------------------------------------------*/
+/* Trace streams */
+
+/* If the environment variable TASKPARTS_LOGGING_STREAM names a file,
+ * the trace is streamed to that file instead of being written as JSON
+ * by output(): a background thread copies, every millisecond, the
+ * records newly pushed in each ring and appends them to the file, in
+ * the binary format below. A trace stream is converted to JSON
+ * offline, by benchmark/trace2json.cpp. If a worker outruns the
+ * writer by more than the capacity of its ring, the records lost are
+ * recorded in the stream as dropped.
+ *
+ * Format: a trace_stream_header, then a sequence of blocks, each of
+ * which is a trace_block_header followed by:
+ *  - trace_block_records: nb trace_records of worker worker_id, which
+ *    follow the previous records block of this worker, or follow a
+ *    trace_block_dropped block;
+ *  - trace_block_dropped: nothing (nb records of worker_id were lost);
+ *  - trace_block_string: the nb characters of the string at address
+ *    arg in the traced program (a source file name of a program
+ *    point), padded with zeros to a multiple of 8 bytes.
+ */
+
+using trace_stream_header = struct trace_stream_header_struct {
+  char magic[8];
+  uint64_t cpu_frequency_khz;
+  uint64_t base_time;
+  uint64_t nb_workers;
+};
+
+static constexpr
+char trace_stream_magic[8] = "TPTRACE";
+
+using trace_block_kind_type = enum trace_block_kind_enum {
+  trace_block_records = 0,
+  trace_block_dropped,
+  trace_block_string
+};
+
+using trace_block_header = struct trace_block_header_struct {
+  uint32_t kind;
+  uint32_t worker_id;
+  uint64_t nb;
+  uint64_t arg;
+};
+
+class trace_stream {
+private:
+
+  mmap_append_file file;
+
+  std::vector<trace_ring*> rings;
+
+  // per worker, index of the next record to stream
+  std::vector<uint64_t> streamed;
+
+  std::vector<trace_record> tmp;
+
+  std::set<const char*> strings;
+
+  std::thread writer;
+
+  std::atomic<bool> stopping;
+
+  auto append_block(trace_block_kind_type kind, size_t id, uint64_t nb, uint64_t arg=0) {
+    trace_block_header b = { .kind = (uint32_t)kind, .worker_id = (uint32_t)id, .nb = nb, .arg = arg };
+    file.append(&b, sizeof(b));
+  }
+
+  auto drain(size_t id) {
+    auto& ring = *rings[id];
+    auto cap = ring.capacity();
+    auto lo = streamed[id];
+    auto hi = ring.get_head();
+    if (hi == lo) {
+      return;
+    }
+    // the owner writes the record of index head into its slot before it
+    // bumps head, so the oldest safe record shares no slot with it
+    auto first_safe = [&] (uint64_t head) {
+      return head + 1 - std::min(head + 1, (uint64_t)cap);
+    };
+    lo = std::max(lo, first_safe(hi));
+    tmp.resize(hi - lo);
+    ring.copy(lo, hi, tmp.data());
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // the records overwritten during the copy are dropped
+    auto hi2 = ring.get_head();
+    auto lo2 = std::min(hi, std::max(lo, first_safe(hi2)));
+    if (lo2 > streamed[id]) {
+      append_block(trace_block_dropped, id, lo2 - streamed[id]);
+    }
+    for (auto i = lo2; i < hi; i++) {
+      auto& r = tmp[i - lo];
+      if ((r.tag == program_point) && (strings.find(r.payload.ppt.source_fname) == strings.end())) {
+        auto str = r.payload.ppt.source_fname;
+        strings.insert(str);
+        auto n = strlen(str);
+        append_block(trace_block_string, id, n, (uint64_t)str);
+        file.append(str, n);
+        uint64_t zeros = 0;
+        file.append(&zeros, (8 - (n % 8)) % 8);
+      }
+    }
+    if (hi > lo2) {
+      append_block(trace_block_records, id, hi - lo2);
+      file.append(&tmp[lo2 - lo], (hi - lo2) * sizeof(trace_record));
+    }
+    streamed[id] = hi;
+  }
+
+  auto drain() {
+    for (size_t id = 0; id != rings.size(); id++) {
+      drain(id);
+    }
+  }
+
+public:
+
+  trace_stream() : stopping(false) { }
+
+  static
+  auto path() -> const char* {
+    return std::getenv("TASKPARTS_LOGGING_STREAM");
+  }
+
+  auto is_streaming() const -> bool {
+    return file.is_open();
+  }
+
+  auto start(const std::vector<trace_ring*>& _rings, uint64_t base_time) {
+    if (! file.open(path())) {
+      taskparts_die("failed to open trace stream %s\n", path());
+    }
+    rings = _rings;
+    streamed.assign(rings.size(), 0);
+    trace_stream_header h;
+    memcpy(h.magic, trace_stream_magic, sizeof(h.magic));
+    h.cpu_frequency_khz = get_cpu_frequency_khz();
+    h.base_time = base_time;
+    h.nb_workers = rings.size();
+    file.append(&h, sizeof(h));
+    stopping.store(false);
+    writer = std::thread([this] {
+      while (! stopping.load()) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  }
+
+  // must be called after the workers stop
+  auto stop() {
+    if (! is_streaming()) {
+      return;
+    }
+    stopping.store(true);
+    writer.join();
+    drain();
+    file.close();
+  }
+
+};
+
+// reads the trace stream in the file at path into one buffer of
+// events per worker, each in the order of the timestamps, and sets
+// the CPU frequency and the base time to those of the traced run;
+// returns false if the file is not a trace stream
+inline
+auto read_trace_stream(const std::string& path, std::vector<buffer_type>& bs,
+                       size_t& nb_dropped) -> bool {
+  std::ifstream in(path, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  size_t pos = 0;
+  auto read = [&] (void* dst, size_t szb) {
+    if (pos + szb > bytes.size()) {
+      return false;
+    }
+    memcpy(dst, &bytes[pos], szb);
+    pos += szb;
+    return true;
+  };
+  trace_stream_header h;
+  if (! read(&h, sizeof(h)) || (memcmp(h.magic, trace_stream_magic, sizeof(h.magic)) != 0)) {
+    return false;
+  }
+  cpu_frequency_khz = h.cpu_frequency_khz;
+  event_type::base_time = h.base_time;
+  bs.assign(h.nb_workers, buffer_type());
+  nb_dropped = 0;
+  // per worker, the cycle count of the last record, if known
+  std::vector<uint64_t> last(h.nb_workers, 0);
+  std::vector<bool> is_last_known(h.nb_workers, false);
+  // source file names of program points, which outlive the call
+  static std::map<uint64_t, std::string> strings;
+  trace_block_header b;
+  while (read(&b, sizeof(b))) {
+    auto id = b.worker_id;
+    if (b.kind == trace_block_dropped) {
+      nb_dropped += b.nb;
+      is_last_known[id] = false;
+    } else if (b.kind == trace_block_string) {
+      std::string str(b.nb, '\0');
+      read(&str[0], b.nb);
+      pos += (8 - (b.nb % 8)) % 8;
+      strings[b.arg] = str;
+    } else if (b.kind == trace_block_records) {
+      for (size_t i = 0; i < b.nb; i++) {
+        trace_record r;
+        if (! read(&r, sizeof(r))) {
+          break;
+        }
+        if (r.is_absolute) {
+          last[id] = r.delta;
+          is_last_known[id] = true;
+        } else if (is_last_known[id]) {
+          last[id] += r.delta;
+        } else {
+          // lost the timestamp after dropped records
+          nb_dropped++;
+          continue;
+        }
+        auto e = r.decode(last[id], id);
+        if (e.tag == program_point) {
+          e.extra.ppt.source_fname = strings[(uint64_t)r.payload.ppt.source_fname].c_str();
+        }
+        bs[id].push_back(e);
+      }
+    }
+  }
+  return true;
+}
+
+/*---------------------------------------------------------------------*/
+/* Log */
   
 template <bool enabled>
 class logging_base {
@@ -187,10 +721,13 @@ public:
   bool real_time;
   
   static
-  perworker::array<buffer_type> buffers;
+  perworker::array<trace_ring> buffers;
   
   static
   bool tracking_kind[nb_kinds];
+
+  static
+  trace_stream stream;
       
   static inline
   void push(event_type e) {
@@ -209,7 +746,7 @@ public:
       e.print_text(stdout);
       release_print_lock();
     }
-    buffers.mine().push_back(e);
+    buffers.mine().push(e);
   }
 
   static inline
@@ -243,6 +780,15 @@ public:
     push(e);
   }
 
+  static inline
+  auto log_fiber_event(event_tag_type tag, void* f, void* g, size_t id) -> void {
+    event_type e(tag);
+    e.extra.fiber_event.f = f;
+    e.extra.fiber_event.g = g;
+    e.extra.fiber_event.id = id;
+    push(e);
+  }
+
   static inline
   auto log_program_point(int line_nb, const char* source_fname, void* ptr) -> void {
     program_point_type ppt = { .line_nb = line_nb, .source_fname = source_fname, .ptr = ptr };
@@ -276,57 +822,125 @@ public:
     if (const auto env_p = std::getenv("TASKPARTS_LOGGING_PROGRAM")) {
       tracking_kind[program] = std::stoi(env_p);
     }
+    std::vector<trace_ring*> rings;
+    for (size_t id = 0; id != perworker::nb_workers(); id++) {
+      buffers[id].allocate(logging_buffer_sz());
+      if (trace_stream::path() != nullptr) {
+        buffers[id].enable_streaming();
+      }
+      rings.push_back(&buffers[id]);
+    }
     reset();
+    if (trace_stream::path() != nullptr) {
+      stream.start(rings, event_type::base_time);
+    }
   }
 
   static
   auto reset() {
-    for (auto id = 0; id != perworker::nb_workers(); id++) {
-      buffers[id].clear();
+    if (! enabled) {
+      return;
+    }
+    if (stream.is_streaming()) {
+      push(event_type(enter_launch));
+      return;
     }
     event_type::base_time = cycles::now();
+    for (size_t id = 0; id != perworker::nb_workers(); id++) {
+      buffers[id].clear(event_type::base_time);
+    }
     push(event_type(enter_launch));
   }
 
+  // writes the events of all workers in the order of their
+  // timestamps, by a k-way merge of the buffers of the workers, each
+  // of which is already in that order; fibers are renamed by compact
+  // ids, numbered from 1 in the order of their creation (a fiber
+  // allocated at the address of a dead one gets a new id), and 0
+  // stands for no fiber
   static
-  void output_json(buffer_type& b, std::string fname) {
+  void output_json(std::vector<buffer_type>& bs, size_t nb_dropped, std::string fname) {
     if (fname == "") {
       return;
     }
+    using cursor_type = std::pair<uint64_t, size_t>; // (cycle count, worker)
+    std::priority_queue<cursor_type, std::vector<cursor_type>, std::greater<cursor_type>> heap;
+    std::vector<size_t> next(bs.size(), 0);
+    size_t i = 0;
+    for (size_t id = 0; id != bs.size(); id++) {
+      i += bs[id].size();
+      if (! bs[id].empty()) {
+        heap.push(std::make_pair(bs[id][0].cycle_count, id));
+      }
+    }
+    std::unordered_map<void*, size_t> fiber_ids;
+    size_t nb_fiber_ids = 0;
+    auto fiber_id = [&] (void* p, bool is_new) -> void* {
+      if (p == nullptr) {
+        return nullptr;
+      }
+      auto it = fiber_ids.find(p);
+      if (is_new || (it == fiber_ids.end())) {
+        auto n = ++nb_fiber_ids;
+        fiber_ids[p] = n;
+        return (void*)n;
+      }
+      return (void*)it->second;
+    };
     FILE* f = fopen(fname.c_str(), "w");
     fprintf(f, "{ \"traceEvents\": [\n");
-    size_t i = b.size();
-    for (auto e : b) {
+    while (! heap.empty()) {
+      auto id = heap.top().second;
+      heap.pop();
+      auto& b = bs[id];
+      auto e = b[next[id]++];
+      if (e.is_fiber_event()) {
+        e.extra.fiber_event.f = fiber_id(e.extra.fiber_event.f, e.tag == fiber_create);
+        e.extra.fiber_event.g = fiber_id(e.extra.fiber_event.g, false);
+      }
       e.print_json(f, (--i == 0));
+      if (next[id] < b.size()) {
+        heap.push(std::make_pair(b[next[id]].cycle_count, id));
+      }
     }
     fprintf(f, "],\n");
+    fprintf(f, "\"otherData\": { \"nb_dropped_events\": \"%lu\" },\n", nb_dropped);
     fprintf(f, "\"displayTimeUnit\": \"ns\"}\n");
     fclose(f);
   }
   
+  // flushes and closes the trace stream, if any; must be called
+  // after the workers stop
+  static
+  void teardown() {
+    if (! enabled) {
+      return;
+    }
+    stream.stop();
+  }
+
   static
   void output(std::string fname) {
     if (! enabled) {
       return;
     }
     push(event_type(exit_launch));
-    buffer_type b;
-    for (auto id = 0; id != perworker::nb_workers(); id++) {
-      buffer_type& b_id = buffers[id];
-      for (auto e : b_id) {
-        b.push_back(e);
-      }
+    if (stream.is_streaming()) {
+      return;
     }
-    std::stable_sort(b.begin(), b.end(), [] (const event_type& e1, const event_type& e2) {
-      return e1.cycle_count < e2.cycle_count;
-    });
-    output_json(b, fname);
+    std::vector<buffer_type> bs(perworker::nb_workers());
+    size_t nb_dropped = 0;
+    for (size_t id = 0; id != perworker::nb_workers(); id++) {
+      buffers[id].decode(id, bs[id]);
+      nb_dropped += buffers[id].nb_dropped();
+    }
+    output_json(bs, nb_dropped, fname);
   }
   
 };
 
 template <bool enabled>
-perworker::array<buffer_type> logging_base<enabled>::buffers;
+perworker::array<trace_ring> logging_base<enabled>::buffers;
 
 template <bool enabled>
 bool logging_base<enabled>::tracking_kind[nb_kinds];
@@ -334,6 +948,9 @@ bool logging_base<enabled>::tracking_kind[nb_kinds];
 template <bool enabled>
 bool logging_base<enabled>::real_time;
 
+template <bool enabled>
+trace_stream logging_base<enabled>::stream;
+
 } // namespace taskparts
 
   
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 #include <assert.h>
 
 #include "timing.hpp"
 #include "diagnostics.hpp"
+#include "perworker.hpp"
 
 namespace taskparts {
 
@@ -115,6 +117,77 @@ using resource_binding_type = enum resource_binding_enum {
 
 pinning_policy_type pinning_policy = pinning_policy_disabled;
 
+/*---------------------------------------------------------------------*/
+/* Locality of worker threads */
+
+// Levels of the memory hierarchy shared by pairs of workers, from the
+// nearest to the farthest; all workers share the machine level.
+using locality_level_type = enum locality_level_enum {
+  locality_level_l2,
+  locality_level_l3,
+  locality_level_numa_node,
+  locality_level_machine,
+  nb_locality_levels
+};
+
+using locality_neighbors_type = std::array<std::vector<size_t>, nb_locality_levels>;
+
+// For each worker and level, the other workers that share the
+// hardware resource of that level with the worker
+perworker::array<locality_neighbors_type> locality_neighbors;
+
+// Nearest level shared by each pair of workers i and j, at
+// locality_levels[i][j]
+perworker::array<std::vector<locality_level_type>> locality_levels;
+
+// Computes the locality information from a predicate shares(level,
+// i, j) that holds when workers i and j share the resource of the
+// given level. Without such information (e.g., no hwloc, or unpinned
+// worker threads), pass a predicate that always returns false, in
+// which case all pairs of workers are at the machine level.
+template <typename Shares>
+auto assign_locality(size_t nb_workers, const Shares& shares) {
+  for (size_t i = 0; i < nb_workers; i++) {
+    auto& levels = locality_levels[i];
+    levels.assign(nb_workers, locality_level_machine);
+    for (auto& ns : locality_neighbors[i]) {
+      ns.clear();
+    }
+    for (size_t j = 0; j < nb_workers; j++) {
+      if (i == j) {
+        continue;
+      }
+      for (int l = 0; l < nb_locality_levels; l++) {
+        auto level = (locality_level_type)l;
+        if ((level == locality_level_machine) || shares(level, i, j)) {
+          if (levels[j] == locality_level_machine) {
+            levels[j] = level;
+          }
+          locality_neighbors[i][level].push_back(j);
+        }
+      }
+    }
+  }
+}
+
+static inline
+auto locality_level_of(size_t i, size_t j) -> locality_level_type {
+  auto& levels = locality_levels[i];
+  if (j >= levels.size()) {
+    return locality_level_machine;
+  }
+  return levels[j];
+}
+
+auto teardown_locality() {
+  for (size_t i = 0; i < perworker::nb_workers(); i++) {
+    for (auto& ns : locality_neighbors[i]) {
+      ns.clear();
+    }
+    locality_levels[i].clear();
+  }
+}
+
 auto pin_calling_worker();
 auto initialize_machine();
 auto teardown_machine();
@@ -133,6 +206,7 @@ auto initialize_machine() {
 }
 auto teardown_machine() {
   posix_teardown_machine();
+  teardown_locality();
 }
 } // end namespace
 #elif defined (TASKPARTS_NAUTILUS)
@@ -143,10 +217,14 @@ auto pin_calling_worker() {
 }
 auto initialize_machine() {
   nautilus_initialize_machine();
+  assign_locality(perworker::nb_workers(), [] (locality_level_type, size_t, size_t) {
+    return false;
+  });
   get_kappa_usec();
 }
 auto teardown_machine() {
   nautilus_teardown_machine();
+  teardown_locality();
 }
 } // end namespace
 #else
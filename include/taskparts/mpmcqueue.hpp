@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <assert.h>
+
+#include "aligned.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Bounded multi-producer multi-consumer queue */
+
+/* A lock-free FIFO queue of fixed capacity (a power of two), after
+ * Dmitry Vyukov's bounded MPMC queue. Each cell carries a sequence
+ * number that tells producers and consumers whether the cell is ready
+ * to be written or read in the current lap around the ring, so that
+ * producers and consumers contend only on their own index.
+ */
+template <typename Item>
+class mpmc_queue {
+private:
+
+  using cell_type = struct cell_struct {
+    std::atomic<size_t> sequence;
+    Item item;
+  };
+
+  std::unique_ptr<cell_type[]> cells;
+
+  size_t mask;
+
+  alignas(TASKPARTS_CACHE_LINE_SZB)
+  std::atomic<size_t> enqueue_pos;
+
+  alignas(TASKPARTS_CACHE_LINE_SZB)
+  std::atomic<size_t> dequeue_pos;
+
+public:
+
+  mpmc_queue(size_t capacity_lg = 12)
+    : cells(new cell_type[(size_t)1 << capacity_lg]),
+      mask(((size_t)1 << capacity_lg) - 1),
+      enqueue_pos(0), dequeue_pos(0) {
+    for (size_t i = 0; i <= mask; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  auto capacity() const -> size_t {
+    return mask + 1;
+  }
+
+  // returns false if the queue is full
+  auto try_push(const Item& x) -> bool {
+    auto pos = enqueue_pos.load(std::memory_order_relaxed);
+    cell_type* c;
+    while (true) {
+      c = &cells[pos & mask];
+      auto seq = c->sequence.load(std::memory_order_acquire);
+      auto d = (intptr_t)seq - (intptr_t)pos;
+      if (d == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (d < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    c->item = x;
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // returns false if the queue is empty
+  auto try_pop(Item& x) -> bool {
+    auto pos = dequeue_pos.load(std::memory_order_relaxed);
+    cell_type* c;
+    while (true) {
+      c = &cells[pos & mask];
+      auto seq = c->sequence.load(std::memory_order_acquire);
+      auto d = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (d == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (d < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    x = c->item;
+    c->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  // the result may be stale
+  auto empty() const -> bool {
+    return dequeue_pos.load(std::memory_order_relaxed) ==
+      enqueue_pos.load(std::memory_order_relaxed);
+  }
+
+};
+
+} // end namespace
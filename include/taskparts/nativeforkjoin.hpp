@@ -3,6 +3,8 @@
 #include "fiber.hpp"
 #include "posix/diagnostics.hpp"
 #include "scheduler.hpp"
+#include "blockpool.hpp"
+#include "workspan.hpp"
 
 #if defined(TASKPARTS_X64)
 #include "x64/context.hpp"
@@ -12,8 +14,63 @@
 #error need to declare platform (e.g., TASKPARTS_X64)
 #endif
 
+// Allocator of the call stacks of native fork-join fibers
+#if defined(TASKPARTS_POSIX) || defined(TASKPARTS_DARWIN)
+#include "posix/stackallocator.hpp"
+namespace taskparts {
+using stack_allocator = mmap_stack_allocator;
+}
+#else
+namespace taskparts {
+using stack_allocator = malloc_block_allocator;
+}
+#endif
+
 namespace taskparts {
 
+/*---------------------------------------------------------------------*/
+/* Call stacks of native fork-join fibers */
+
+/* The size of each call stack is given by the environment variable
+ * TASKPARTS_FIBER_STACK_SZB (by default, context::dflt_thread_stack_szb),
+ * which includes the trailer of its block (see blockpool.hpp), so that
+ * the mapping of a stack takes no more pages than the stack itself.
+ * The pool is never destroyed, because fibers may outlive static
+ * destructors.
+ */
+auto stack_pool() -> block_pool<stack_allocator>& {
+  static block_pool<stack_allocator>* p = [] {
+    size_t szb = context::dflt_thread_stack_szb;
+    if (const auto env_p = std::getenv("TASKPARTS_FIBER_STACK_SZB")) {
+      auto n = std::stoll(env_p);
+      if (n <= (1 << 12)) {
+        taskparts_die("TASKPARTS_FIBER_STACK_SZB must be greater than 4096 bytes\n");
+      }
+      szb = (size_t)n;
+    }
+    auto a = context::thread_stack_alignb;
+    auto payload_szb = ((szb - block_pool<stack_allocator>::trailer_szb) / a) * a;
+    return new block_pool<stack_allocator>(payload_szb, a, 64);
+  }();
+  return *p;
+}
+
+// number of stacks in use, by the worker that allocated them
+perworker::array<std::atomic<size_t>> nb_live_stacks;
+
+template <typename Scheduler>
+auto allocate_stack() -> char* {
+  auto s = (char*)stack_pool().allocate();
+  Scheduler::on_live_stacks(++nb_live_stacks.mine());
+  return s;
+}
+
+auto release_stack(char* s) {
+  auto& sp = stack_pool();
+  nb_live_stacks.global(sp.owner_of(s))--;
+  sp.deallocate(s);
+}
+
 /*---------------------------------------------------------------------*/
 /* Fork join using conventional C/C++ calling conventions */
 
@@ -40,9 +97,20 @@ public:
 
   fiber_status_type status = fiber_status_finish;
 
+  // true once the body of this fiber has returned, i.e., once nothing
+  // remains to run on its call stack
+  bool finished_body = false;
+
   // pointer to the call stack of this thread
   char* stack = nullptr;
 
+  // worker that last entered this fiber, if any (tracked only if
+  // logging)
+  static constexpr
+  size_t no_worker = ~((size_t)0);
+
+  size_t last_worker = no_worker;
+
   char* tmp_stack = nullptr;
   
   // CPU context of this thread
@@ -57,7 +125,7 @@ public:
     assert(stack != after_yield);
     auto s = stack;
     stack = nullptr;
-    free(s);
+    release_stack(s);
   }
 
   auto swap_with_scheduler() {
@@ -80,9 +148,16 @@ public:
   // point of entry from the scheduler to the body of this thread
   // the scheduler may reenter this fiber via this method
   auto exec() -> fiber_status_type {
+#ifdef TASKPARTS_LOG
+    if (last_worker != no_worker) {
+      Scheduler::log_fiber_event(fiber_resume, this, nullptr, last_worker);
+    }
+    last_worker = perworker::my_id();
+#endif
     if (stack == nullptr) {
       // initial entry by the scheduler into the body of this thread
-      stack = context::spawn(context::addr(ctx), this);
+      stack = context::spawn(context::addr(ctx), this, allocate_stack<Scheduler>(),
+                             stack_pool().payload_szb());
     }
     if (stack == after_yield) {
       status = fiber_status_finish;
@@ -91,6 +166,14 @@ public:
     current_fiber.mine() = this;
     // jump into body of this thread
     context::swap(my_ctx(), context::addr(ctx), this);
+    if (finished_body && (stack != nullptr) && (stack != notownstackptr)) {
+      // the stack is dead, so this worker can reuse it right away for
+      // its next stolen fiber, rather than waiting for the
+      // destruction of this fiber (e.g., at the join point of its parent)
+      auto s = stack;
+      stack = notownstackptr;
+      release_stack(s);
+    }
     return status;
   }
 
@@ -100,6 +183,7 @@ public:
     assert(f != nullptr);
     assert(f != (nativefj_fiber*)notaptr);
     f->run();
+    f->finished_body = true;
     // terminate this fiber by exiting to scheduler
     exit_to_scheduler();
   }
@@ -109,12 +193,20 @@ public:
   }
 
   auto _fork1join(fiber<Scheduler>* f) {
+#ifdef TASKPARTS_WORKSPAN
+    // the strand of the caller ends here, and f is not timed (see
+    // workspan.hpp)
+    auto w = workspan_suspend();
+#endif
     tmp_stack = stack;
     stack = after_yield;
     fiber<Scheduler>::add_edge(f, this);
     status = fiber_status_pause;
     f->release();
     swap_with_scheduler();
+#ifdef TASKPARTS_WORKSPAN
+    workspan_resume(w);
+#endif
   }
 
   static
@@ -249,7 +341,7 @@ public:
 bool force_sequential = false;
 
 template <typename F1, typename F2, typename Scheduler=minimal_scheduler<>>
-auto fork2join(const F1& f1, const F2& f2, Scheduler sched=Scheduler()) {
+auto _fork2join(const F1& f1, const F2& f2, Scheduler sched=Scheduler()) {
   if (force_sequential) {
     f1();
     f2();
@@ -265,6 +357,22 @@ auto fork2join(const F1& f1, const F2& f2, Scheduler sched=Scheduler()) {
 #endif
 }
 
+template <typename F1, typename F2, typename Scheduler=minimal_scheduler<>>
+auto fork2join(const F1& f1, const F2& f2, Scheduler sched=Scheduler()) {
+#ifdef TASKPARTS_WORKSPAN
+  auto w = workspan_suspend();
+  workspan_type w1, w2;
+  _fork2join([&] {
+    w1 = workspan_run(w.site, f1);
+  }, [&] {
+    w2 = workspan_run(w.site, f2);
+  }, sched);
+  workspan_resume(workspan_join(w, w1, w2));
+#else
+  _fork2join(f1, f2, sched);
+#endif
+}
+
 /*---------------------------------------------------------------------*/
 /* Parallel futures */
 
@@ -292,9 +400,37 @@ public:
   
   nativefj_fiber<Scheduler>* cf;
 
+#ifdef TASKPARTS_WORKSPAN
+  // work and span of the spawner when it spawned, and of the body
+  workspan_type ws_spawn, ws_body;
+#endif
+
   lazy_future(const F& f, Scheduler sched=Scheduler())
     : fiber<Scheduler>(), f(std::move(f)), status(initial_state), refcount(2) {
     cf = nativefj_fiber<Scheduler>::current_fiber.mine();
+#ifdef TASKPARTS_WORKSPAN
+    ws_spawn = workspan_suspend();
+    workspan_resume(ws_spawn);
+#endif
+  }
+
+  auto run_body() {
+#ifdef TASKPARTS_WORKSPAN
+    ws_body = workspan_run(ws_spawn.site, f);
+#else
+    f();
+#endif
+  }
+
+  // joins the body with the forcer, which must call this function
+  // before it decrements the reference count
+  auto on_forced() {
+#ifdef TASKPARTS_WORKSPAN
+    auto w = workspan_suspend();
+    w.work += ws_body.work;
+    w.span = std::max(w.span, ws_spawn.span + ws_body.span);
+    workspan_resume(w);
+#endif
   }
 
   fiber_status_type run() {
@@ -324,7 +460,7 @@ public:
         }
       }
       //TASKPARTS_LOG_PPT(Scheduler, cf);
-      f();
+      run_body();
       //TASKPARTS_LOG_PPT(Scheduler, cf);
       while (true) {
         auto s = status.load();
@@ -370,6 +506,7 @@ public:
         if (context::capture<nativefj_fiber<Scheduler>*>(context::addr(cf->ctx))) {
           cf->status = st;
           //TASKPARTS_LOG_PPT(Scheduler, cf);
+          on_forced();
           decr_refcount();
           return;
         }
@@ -378,6 +515,7 @@ public:
         cf->exit_to_scheduler();
         assert(false);
       } else if (s == remote_ran_state) {
+        on_forced();
         decr_refcount();
         return;
       } else {
@@ -385,8 +523,9 @@ public:
       }
     }
     //TASKPARTS_LOG_PPT(Scheduler, cf);
-    f();
+    run_body();
     //TASKPARTS_LOG_PPT(Scheduler, cf);
+    on_forced();
     decr_refcount();
   }
 
@@ -2,11 +2,21 @@
 
 #include <string>
 #include <cstdint>
+#include <cstdlib>
+#include <algorithm>
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <functional>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "machine.hpp"
 #include "atomic.hpp"
+#include "defaults.hpp"
 #include "nativeforkjoin.hpp"
+#include "workspan.hpp"
 
 namespace taskparts {
 
@@ -14,7 +24,41 @@ using complexity_type = int64_t;
 
 /*---------------------------------------------------------------------*/
 /* The estimator data structure */
-  
+
+/* An estimator keeps, for a call site of spguard(), the cost per unit
+ * of complexity (c) of the largest complexity (nmax) whose run took
+ * no more than kappa cycles. The state shared by all workers is
+ * merged from the reports of the workers, but each worker decides by
+ * is_small() from a copy of its own (its shard), which it refreshes
+ * from the shared state every TASKPARTS_ESTIMATOR_REFRESH_PERIOD
+ * calls (by default, 64). A report updates the shard of its worker
+ * and, only if it improves on the shared state, the shared state, so
+ * that the shared state is written rarely once the estimate
+ * converges, and read once per refresh period. With stats enabled,
+ * the counters nb_estimator_refreshes and nb_estimator_cas_failures
+ * count the refreshes of shards and the failed attempts to update
+ * the shared state.
+ */
+
+auto estimator_refresh_period() -> uint64_t {
+  static uint64_t p = [] {
+    uint64_t p = 64;
+    if (const auto env_p = std::getenv("TASKPARTS_ESTIMATOR_REFRESH_PERIOD")) {
+      p = std::max(1, std::stoi(env_p));
+    }
+    return p;
+  }();
+  return p;
+}
+
+class estimator;
+
+// all estimators, in the order of their construction
+auto estimators() -> std::vector<estimator*>& {
+  static std::vector<estimator*> es;
+  return es;
+}
+
 class estimator {
 private:
 
@@ -23,14 +67,43 @@ private:
     uint64_t u;
   };
 
+  using shard_type = struct shard_struct {
+    state_type s;
+    uint64_t nb_calls;
+  };
+
   alignas(TASKPARTS_CACHE_LINE_SZB)
   std::atomic<uint64_t> s;
 
   alignas(TASKPARTS_CACHE_LINE_SZB)
   std::string name;
 
+  // name without the address of the estimator, which is stable
+  // across runs (see granularity profiles below)
+  std::string key;
+
+  perworker::array<shard_type> shards;
+
   static constexpr
   float alpha = 1.5;
+
+public:
+
+#ifdef TASKPARTS_WORKSPAN
+  // work and span of the outermost runs of the spguard() site
+  workspan_site workspan;
+#endif
+
+private:
+
+  auto my_shard() -> shard_type& {
+    auto& sh = shards.mine();
+    if ((sh.nb_calls++ % estimator_refresh_period()) == 0) {
+      sh.s.u = s.load(std::memory_order_relaxed);
+      bench_stats::increment(stats_configuration::nb_estimator_refreshes);
+    }
+    return sh;
+  }
     
 public:
 
@@ -38,38 +111,67 @@ public:
     state_type s0;
     s0.f = {.c = 0, .nmax = 0 };
     s.store(s0.u);
+    for (size_t i = 0; i < shards.size(); i++) {
+      shards.global(i).s = s0;
+      shards.global(i).nb_calls = 0;
+    }
     std::stringstream stream;
     stream << name.substr(0, std::min(40, (int)name.length())) << this;
     this->name = stream.str();
+    key = name;
+    estimators().push_back(this);
   }
 
   auto get_name() -> const char* {
     return name.c_str();
   }  
 
+  auto get_key() -> const std::string& {
+    return key;
+  }
+
+  auto get_state(float& c, int& nmax) -> void {
+    state_type ls;
+    ls.u = s.load();
+    c = ls.f.c;
+    nmax = ls.f.nmax;
+  }
+
+  // must be called while no worker uses the estimator
+  auto set_state(float c, int nmax) -> void {
+    state_type ls;
+    ls.f = {.c = c, .nmax = nmax };
+    s.store(ls.u);
+    for (size_t i = 0; i < shards.size(); i++) {
+      shards.global(i).s = ls;
+      shards.global(i).nb_calls = 0;
+    }
+  }
+
   auto report(complexity_type n, uint64_t t) {
     auto kappa = get_kappa_cycles();
-    bool done = false;
-    do {
-      state_type _ls;
-      _ls.u = s.load();
-      auto ls = _ls.f;
-      auto nmax = (complexity_type)ls.nmax;
-      if ((t <= kappa) && (n > nmax)) {
-        auto c2 = (float)t / (float)n;
-        state_type ls2;
-        ls2.f = {.c = c2, .nmax = (int)n};
-        done = s.compare_exchange_strong(_ls.u, ls2.u);
-      } else {
-        done = true;
+    if (t > kappa) {
+      return;
+    }
+    auto& sh = shards.mine();
+    if (n <= (complexity_type)sh.s.f.nmax) {
+      return;
+    }
+    state_type ls2;
+    ls2.f = {.c = (float)t / (float)n, .nmax = (int)n};
+    sh.s = ls2;
+    state_type _ls;
+    _ls.u = s.load();
+    while (n > (complexity_type)_ls.f.nmax) {
+      if (s.compare_exchange_strong(_ls.u, ls2.u)) {
+        break;
       }
-    } while (! done);
+      bench_stats::increment(stats_configuration::nb_estimator_cas_failures);
+    }
   }
 
   auto is_small(complexity_type n) -> bool {
-    state_type _ls;
-    _ls.u = s.load();
-    auto ls = _ls.f;
+    auto ls = my_shard().s.f;
     auto c = ls.c;
     auto nmax = ls.nmax;
     auto kappa = (float)get_kappa_cycles();
@@ -79,6 +181,176 @@ public:
   
 };
 
+/*---------------------------------------------------------------------*/
+/* Granularity profiles */
+
+/* A granularity profile saves the states of the estimators at the end
+ * of a run, so that the next run of the same program can start from
+ * tuned estimators rather than from c = 0 and nmax = 0. The profile is
+ * the file named by the environment variable
+ * TASKPARTS_GRANULARITY_PROFILE; if the variable is not set, the
+ * functions below do nothing. An estimator is identified in the
+ * profile by its key (the name given to spguard<ename>(), followed by
+ * the rank of the estimator among those with the same name, in the
+ * order of their construction). Because c is measured in cycles and
+ * nmax depends on kappa, the profile also records the CPU frequency
+ * and kappa. Because the ranks, and even the keys of sites of the
+ * default name, depend on the order in which the program constructs
+ * its estimators, the profile also records the number of estimators
+ * and a fingerprint of the executable (its path, size, and
+ * modification time), so that a profile recorded by another build is
+ * not applied to the wrong sites. A profile that differs in any of
+ * these is stale: load_granularity_profile() ignores it, and
+ * save_granularity_profile() overwrites it.
+ */
+
+auto granularity_profile_path() -> const char* {
+  return std::getenv("TASKPARTS_GRANULARITY_PROFILE");
+}
+
+// returns a hash of the path, size, and modification time of the
+// running executable, or 0 if they are unknown
+auto executable_fingerprint() -> uint64_t {
+  char path[4096];
+  auto n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (n <= 0) {
+    return 0;
+  }
+  path[n] = '\0';
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return 0;
+  }
+  std::stringstream stream;
+  stream << path << ":" << st.st_size << ":" << st.st_mtime;
+  return (uint64_t)std::hash<std::string>{}(stream.str());
+}
+
+auto granularity_profile_keys() -> std::vector<std::string> {
+  std::vector<std::string> keys;
+  std::map<std::string, size_t> ranks;
+  for (auto e : estimators()) {
+    auto& k = e->get_key();
+    keys.push_back(k + "#" + std::to_string(ranks[k]++));
+  }
+  return keys;
+}
+
+// returns true iff a profile was found, was not stale, and was loaded;
+// must be called after initialize_machine() and before any worker
+// uses an estimator
+auto load_granularity_profile() -> bool {
+  auto path = granularity_profile_path();
+  if (path == nullptr) {
+    return false;
+  }
+  std::ifstream in(path);
+  std::string tag;
+  uint64_t k_usec, freq_khz, nb_estimators, fingerprint;
+  if (! (in >> tag >> k_usec >> freq_khz >> nb_estimators >> fingerprint) ||
+      (tag != "taskparts_granularity_profile")) {
+    return false;
+  }
+  if ((k_usec != get_kappa_usec()) || (freq_khz != get_cpu_frequency_khz()) ||
+      (nb_estimators != estimators().size()) || (fingerprint != executable_fingerprint())) {
+    return false;
+  }
+  std::map<std::string, std::pair<float, int>> states;
+  float c;
+  int nmax;
+  std::string key;
+  while (in >> c >> nmax >> key) {
+    states[key] = std::make_pair(c, nmax);
+  }
+  auto keys = granularity_profile_keys();
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto it = states.find(keys[i]);
+    if (it != states.end()) {
+      estimators()[i]->set_state(it->second.first, it->second.second);
+    }
+  }
+  return true;
+}
+
+// must be called after the workers stop
+auto save_granularity_profile() -> void {
+  auto path = granularity_profile_path();
+  if (path == nullptr) {
+    return;
+  }
+  std::ofstream out(path);
+  out << "taskparts_granularity_profile " << get_kappa_usec() << " "
+      << get_cpu_frequency_khz() << " " << estimators().size() << " "
+      << executable_fingerprint() << "\n";
+  auto keys = granularity_profile_keys();
+  for (size_t i = 0; i < keys.size(); i++) {
+    float c;
+    int nmax;
+    estimators()[i]->get_state(c, nmax);
+    if (nmax > 0) {
+      out << c << " " << nmax << " " << keys[i] << "\n";
+    }
+  }
+}
+
+/*---------------------------------------------------------------------*/
+/* Work and span reports */
+
+/* With TASKPARTS_WORKSPAN (see workspan.hpp), the benchmark harness
+ * measures the work and span of each run of the benchmark, and each
+ * spguard() site those of its outermost calls, and
+ * output_workspan_summary() reports them as a JSON array, in the file
+ * named by TASKPARTS_WORKSPAN_OUTFILE or else on stdout.
+ */
+
+workspan_site workspan_program;
+
+// forgets the runs so far, e.g., those of warmup runs
+auto reset_workspan_sites() -> void {
+#ifdef TASKPARTS_WORKSPAN
+  workspan_program.reset();
+  for (auto e : estimators()) {
+    e->workspan.reset();
+  }
+#endif
+}
+
+auto output_workspan_summary() -> void {
+#ifdef TASKPARTS_WORKSPAN
+  FILE* f = stdout;
+  if (const auto env_p = std::getenv("TASKPARTS_WORKSPAN_OUTFILE")) {
+    f = fopen(env_p, "w");
+  }
+  auto output_site = [&] (const std::string& name, workspan_site& s, bool last) {
+    auto work = s.work.load();
+    auto span = s.span.load();
+    fprintf(f, "{\"site\": \"%s\",\n", name.c_str());
+    fprintf(f, "\"nb_runs\": %lu,\n", s.nb_runs.load());
+    fprintf(f, "\"work_cycles\": %lu,\n", work);
+    fprintf(f, "\"span_cycles\": %lu,\n", span);
+    fprintf(f, "\"parallelism\": %.3f}%s\n", (span == 0) ? 0.0 : (double)work / (double)span,
+            last ? "" : ",");
+  };
+  fprintf(f, "[\n");
+  auto keys = granularity_profile_keys();
+  size_t nb_sites = 0;
+  for (auto e : estimators()) {
+    nb_sites += (e->workspan.nb_runs.load() > 0) ? 1 : 0;
+  }
+  output_site("program", workspan_program, nb_sites == 0);
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto& s = estimators()[i]->workspan;
+    if (s.nb_runs.load() > 0) {
+      output_site(keys[i], s, --nb_sites == 0);
+    }
+  }
+  fprintf(f, "]\n");
+  if (f != stdout) {
+    fclose(f);
+  }
+#endif
+}
+
 /*---------------------------------------------------------------------*/
 /* Series-parallel guard */
   
@@ -107,10 +379,10 @@ template <
   class Par_body,
   class Seq_body
   >
-auto _spguard(estimator& estim,
-              const Complexity& complexity,
-              const Par_body& par_body,
-              const Seq_body& seq_body) {
+auto _spguard_body(estimator& estim,
+                   const Complexity& complexity,
+                   const Par_body& par_body,
+                   const Seq_body& seq_body) {
   if (is_small.mine()) {
     seq_body();
     return;
@@ -132,6 +404,34 @@ auto _spguard(estimator& estim,
   }
 }  
 
+// with TASKPARTS_WORKSPAN, reports the work and span of the call to
+// the site of estim, unless it is nested in another call to that site
+template <
+  class Complexity,
+  class Par_body,
+  class Seq_body
+  >
+auto _spguard(estimator& estim,
+              const Complexity& complexity,
+              const Par_body& par_body,
+              const Seq_body& seq_body) {
+#ifdef TASKPARTS_WORKSPAN
+  auto w = workspan_suspend();
+  if (w.site != &estim.workspan) {
+    auto w1 = workspan_run(&estim.workspan, [&] {
+      _spguard_body(estim, complexity, par_body, seq_body);
+    });
+    estim.workspan.report(w1);
+    w.work += w1.work;
+    w.span += w1.span;
+    workspan_resume(w);
+    return;
+  }
+  workspan_resume(w);
+#endif
+  _spguard_body(estim, complexity, par_body, seq_body);
+}
+
 template <class Last>
 auto type_name() -> std::string {
   //  assert(false);
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+
+#include "perworker.hpp"
+#include "scheduler.hpp"
+#if defined(TASKPARTS_POSIX) || defined(TASKPARTS_DARWIN)
+#include "posix/futex.hpp"
+#else
+#error need to declare platform (e.g., TASKPARTS_POSIX)
+#endif
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Parking of idle workers */
+
+/* A policy for the non-elastic work-stealing scheduler, in the place
+ * of minimal_elastic, by which idle workers park on a futex instead
+ * of spinning on steal attempts. A thief that fails
+ * TASKPARTS_PARK_AFTER_ROUNDS rounds of steal attempts in a row
+ * registers as a sleeper and then makes one more round, so that work
+ * pushed in the meantime is either found by that round or signaled to
+ * the thief. If this last round fails, the thief parks until it is
+ * woken by a push or for at most TASKPARTS_PARK_TIMEOUT_USEC
+ * microseconds, after which it resumes stealing.
+ *
+ * A push onto an empty deque, as reported by the push of the deque,
+ * wakes up one parked worker (a deque whose push reports
+ * deque_surplus_unknown wakes one on every push). The pusher stores to
+ * its deque, then fences, then checks for registered thieves, whereas
+ * a thief registers by an atomic increment before its last round, so
+ * that one of the two sees the other. Such a push costs a fence and a
+ * load of a shared counter while no worker is registered. A push onto
+ * a deque that its owner sees as nonempty wakes no one, even if a
+ * concurrent steal just emptied it; the thief of that steal is awake,
+ * and the timeout bounds the delay anyway.
+ * Likewise, each fiber injected by a thread that is not a worker
+ * (see pool.hpp) wakes up one parked worker. Each instance of the
+ * policy, as distinguished by Tag, parks and wakes up its workers
+ * independently of the others.
+ */
+template <typename Stats, typename Logging, typename Tag=void>
+class parking {
+public:
+
+  static constexpr
+  bool override_rand_worker = false;
+
+  static constexpr
+  bool needs_surplus = false;
+
+  static constexpr
+  bool notify_on_unknown_surplus = true;
+
+  using worker_state_type = struct worker_state_struct {
+    size_t nb_failed_rounds = 0;
+    bool registered = false;
+    uint32_t epoch = 0;
+  };
+
+  static
+  perworker::array<worker_state_type> states;
+
+  // futex word, incremented by each wakeup
+  static
+  std::atomic<uint32_t> epoch;
+
+  // number of workers registered as sleepers (parked or about to park)
+  static
+  std::atomic<int> nb_registered;
+
+  static
+  std::atomic<int> nb_parked;
+
+  static
+  size_t park_after_rounds;
+
+  static
+  uint64_t park_timeout_usec;
+
+  static
+  auto initialize() {
+    park_after_rounds = 4;
+    if (const auto env_p = std::getenv("TASKPARTS_PARK_AFTER_ROUNDS")) {
+      park_after_rounds = std::max(1, std::stoi(env_p));
+    }
+    park_timeout_usec = 10000;
+    if (const auto env_p = std::getenv("TASKPARTS_PARK_TIMEOUT_USEC")) {
+      park_timeout_usec = std::max(1, std::stoi(env_p));
+    }
+    for (size_t i = 0; i < perworker::nb_workers(); i++) {
+      states[i] = worker_state_type();
+    }
+    nb_registered.store(0);
+    nb_parked.store(0);
+  }
+
+  static
+  auto try_to_sleep(size_t) {
+    worker_yield();
+  }
+
+  static
+  auto wake_one() {
+    // orders the store of the push (or injection) before the load
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (nb_registered.load() == 0) {
+      return;
+    }
+    epoch++;
+    if (nb_parked.load() > 0) {
+      futex_wake(&epoch, 1);
+    }
+  }
+
+  static
+  auto wake_all() {
+    epoch++;
+    futex_wake(&epoch);
+  }
+
+  static
+  auto incr_stealing(size_t my_id = perworker::my_id()) {
+    states[my_id].nb_failed_rounds = 0;
+  }
+
+  static
+  auto decr_stealing(size_t my_id = perworker::my_id()) {
+    auto& s = states[my_id];
+    if (s.registered) {
+      s.registered = false;
+      nb_registered--;
+    }
+    s.nb_failed_rounds = 0;
+  }
+
+  static
+  auto incr_surplus(size_t my_id = perworker::my_id()) {
+    wake_one();
+  }
+
+  static
+  auto decr_surplus(size_t target_id = perworker::my_id()) { }
+
+  static
+  auto try_suspend(size_t) {
+    auto my_id = perworker::my_id();
+    auto& s = states[my_id];
+    if (! s.registered) {
+      if (++s.nb_failed_rounds < park_after_rounds) {
+        return;
+      }
+      s.epoch = epoch.load();
+      s.registered = true;
+      nb_registered++;
+      return;
+    }
+    nb_parked++;
+    Stats::on_exit_acquire();
+    Logging::log_enter_sleep(my_id, 0l, 0l);
+    Stats::on_enter_sleep();
+    futex_wait(&epoch, s.epoch, park_timeout_usec);
+    Stats::on_exit_sleep();
+    Logging::log_event(exit_sleep);
+    Stats::on_enter_acquire();
+    nb_parked--;
+    s.epoch = epoch.load();
+  }
+
+  template <typename Is_deque_empty>
+  static
+  auto random_worker_with_surplus(const Is_deque_empty& is_deque_empty,
+                                  size_t my_id) -> int {
+    return -1;
+  }
+
+  static
+  auto scale_up() -> void { }
+
+  static
+  auto exists_imbalance() -> bool {
+    return false;
+  }
+
+  static
+  auto on_termination() {
+    wake_all();
+  }
+
+  static
+  auto on_inject() {
+    wake_one();
+  }
+
+};
+
+template <typename Stats, typename Logging, typename Tag>
+perworker::array<typename parking<Stats, Logging, Tag>::worker_state_type> parking<Stats, Logging, Tag>::states;
+
+template <typename Stats, typename Logging, typename Tag>
+std::atomic<uint32_t> parking<Stats, Logging, Tag>::epoch(0);
+
+template <typename Stats, typename Logging, typename Tag>
+std::atomic<int> parking<Stats, Logging, Tag>::nb_registered(0);
+
+template <typename Stats, typename Logging, typename Tag>
+std::atomic<int> parking<Stats, Logging, Tag>::nb_parked(0);
+
+template <typename Stats, typename Logging, typename Tag>
+size_t parking<Stats, Logging, Tag>::park_after_rounds = 4;
+
+template <typename Stats, typename Logging, typename Tag>
+uint64_t parking<Stats, Logging, Tag>::park_timeout_usec = 10000;
+
+} // end namespace
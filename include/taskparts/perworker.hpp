@@ -48,13 +48,21 @@ public:
     return capacity;
   }
 
+  // slot of worker i of the domain of the caller
   reference operator[](size_t i) {
-    assert(i < capacity);
-    return items[i];
+    auto j = id::get_base() + i;
+    assert(j < capacity);
+    return items[j];
   }
 
   auto mine() -> reference {
-    return items[id::get_my_id()];
+    return items[my_global_id()];
+  }
+
+  // slot of index i across all domains (see my_global_id())
+  auto global(size_t i) -> reference {
+    assert(i < capacity);
+    return items[i];
   }
   
 };
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <assert.h>
+
+#include "machine.hpp"
+#include "nativeforkjoin.hpp"
+#include "workstealing.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Persistent worker pools */
+
+/* A worker pool launches the work-stealing scheduler once and keeps
+ * its workers up until the pool shuts down, so that threads that are
+ * not workers (e.g., the threads of a service) can submit jobs to
+ * it. A job pays neither for the creation of worker threads nor for
+ * initialize_machine() (e.g., loading the hwloc topology); it pays
+ * just for a push to the injection queue of the scheduler, which idle
+ * workers poll before their steal attempts. With the compiler flag
+ * TASKPARTS_PARK_IDLE_WORKERS, each submission also wakes up a parked
+ * worker; otherwise, idle workers keep polling.
+ *
+ * A job is a callable taking the scheduler, like the argument of
+ * launch(), and it runs as a native fork-join fiber, so it may call
+ * fork2join() and the like. submit() returns a future for the result
+ * of the job, and submit_and_wait() blocks its caller until the job
+ * finishes. shutdown() (or the destructor) waits for all submitted
+ * jobs to finish and then stops the workers.
+ *
+ * Each pool runs its workers in a worker domain of its own (see
+ * posix/perworkerid.hpp), i.e., on threads of its own and on
+ * per-worker state (deques, call stacks, stats, etc.) that is
+ * disjoint from that of launch() and of the other pools. Pools of
+ * distinct Tag types can thus run side by side, e.g., one for the
+ * ingest stage and another for the analytics stage of a service,
+ * possibly pinned to distinct sockets (see hwloc_assign_cpusets()).
+ * Two pools of the same Tag share static scheduler state, so they may
+ * not be up at the same time. The default Tag is private to pools, and
+ * Tag may not be void, which is the tag of the scheduler of launch().
+ */
+struct dflt_pool_tag { };
+
+template <typename Tag=dflt_pool_tag,
+	  template <typename> typename Deque=dflt_deque,
+	  typename Victim_selection=dflt_victim_selection>
+class pool {
+public:
+
+  static_assert(! std::is_same_v<Tag, void>,
+                "the tag void is that of the scheduler of launch()");
+
+  using scheduler_type = minimal_scheduler<minimal_stats, minimal_logging,
+					   minimal_worker, minimal_interrupt, Deque, Victim_selection, Tag>;
+
+  using work_stealing_type = work_stealing<scheduler_type, fiber, minimal_stats, minimal_logging,
+					   minimal_worker, minimal_interrupt, Deque, Victim_selection>;
+
+private:
+
+  // unlike fork2join fibers, jobs live on the heap
+  template <typename F>
+  class job_fiber : public nativefj_from_lambda<F, scheduler_type> {
+  public:
+
+    job_fiber(const F& f) : nativefj_from_lambda<F, scheduler_type>(f) { }
+
+    void finish() {
+      fiber<scheduler_type>::notify();
+      delete this;
+    }
+
+  };
+
+  std::thread launcher;
+
+  perworker::domain_type domain;
+
+  bool is_up = false;
+
+  // true iff a pool of this type is up
+  static
+  std::atomic<bool> type_in_use;
+
+  // number of jobs submitted and not yet finished
+  std::atomic<size_t> nb_pending;
+
+  std::mutex pending_lock;
+
+  std::condition_variable pending_condition;
+
+  auto finish_job() {
+    if (--nb_pending == 0) {
+      std::lock_guard<std::mutex> lk(pending_lock);
+      pending_condition.notify_all();
+    }
+  }
+
+public:
+
+  pool(size_t nb_workers = perworker::nb_workers_requested()) : nb_pending(0) {
+    if (type_in_use.exchange(true)) {
+      taskparts_die("Requested a second worker pool of the same type\n");
+    }
+    domain = perworker::id::reserve_domain(nb_workers);
+    work_stealing_type::awaits_injections.store(true);
+    launcher = std::thread([d = domain] {
+      perworker::id::enter_domain(d);
+      initialize_machine();
+      work_stealing_type::launch();
+      teardown_machine();
+    });
+    is_up = true;
+  }
+
+  pool(const pool&) = delete;
+
+  ~pool() {
+    shutdown();
+  }
+
+  template <typename F>
+  auto submit(const F& f) {
+    using result_type = decltype(f(scheduler_type()));
+    assert(is_up);
+    auto p = std::make_shared<std::promise<result_type>>();
+    auto r = p->get_future();
+    auto body = [this, p, f] {
+      try {
+        if constexpr (std::is_void_v<result_type>) {
+          f(scheduler_type());
+          p->set_value();
+        } else {
+          p->set_value(f(scheduler_type()));
+        }
+      } catch (...) {
+        p->set_exception(std::current_exception());
+      }
+      finish_job();
+    };
+    nb_pending++;
+    auto j = new job_fiber<decltype(body)>(body);
+    j->incounter.store(0);
+    work_stealing_type::inject(j);
+    return r;
+  }
+
+  // must not be called by a worker of this pool, which would
+  // otherwise block
+  template <typename F>
+  auto submit_and_wait(const F& f) {
+    assert(! (perworker::is_worker() && (perworker::id::get_base() == domain.base)));
+    return submit(f).get();
+  }
+
+  auto shutdown() {
+    if (! is_up) {
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lk(pending_lock);
+      pending_condition.wait(lk, [&] { return nb_pending.load() == 0; });
+    }
+    auto t = new terminal_fiber<scheduler_type>;
+    t->incounter.store(0);
+    work_stealing_type::inject(t);
+    launcher.join();
+    work_stealing_type::awaits_injections.store(false);
+    perworker::id::release_domain(domain);
+    type_in_use.store(false);
+    is_up = false;
+  }
+
+};
+
+template <typename Tag,
+	  template <typename> typename Deque,
+	  typename Victim_selection>
+std::atomic<bool> pool<Tag, Deque, Victim_selection>::type_in_use(false);
+
+} // end namespace
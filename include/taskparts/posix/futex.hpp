@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#include <chrono>
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Futexes */
+
+/* Blocks the caller while the value of w equals expected, for at most
+ * timeout_usec microseconds (or until a call to futex_wake on w). The
+ * call may return spuriously. Without futex support, the call sleeps
+ * for the timeout.
+ */
+static inline
+auto futex_wait(std::atomic<uint32_t>* w, uint32_t expected, uint64_t timeout_usec) {
+#ifdef __linux__
+  struct timespec ts;
+  ts.tv_sec = (time_t)(timeout_usec / 1000000);
+  ts.tv_nsec = (long)((timeout_usec % 1000000) * 1000);
+  syscall(SYS_futex, (uint32_t*)w, FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+#else
+  if (w->load() == expected) {
+    std::this_thread::sleep_for(std::chrono::microseconds(timeout_usec));
+  }
+#endif
+}
+
+// Wakes up at most nb callers blocked on w
+static inline
+auto futex_wake(std::atomic<uint32_t>* w, int nb = INT_MAX) {
+#ifdef __linux__
+  syscall(SYS_futex, (uint32_t*)w, FUTEX_WAKE_PRIVATE, nb, nullptr, nullptr, 0);
+#endif
+}
+
+} // end namespace
@@ -2,6 +2,7 @@
 
 #include <cstdio>
 #include <assert.h>
+#include <mutex>
 #include <pthread.h>
 #include <vector>
 #ifdef TASKPARTS_HAVE_HWLOC
@@ -69,15 +70,24 @@ auto hwloc_assign_cpusets(size_t nb_workers,
   if (nb_objects == 0) {
     taskparts_die("request to bind taskpartsworker threads to a nonexistent hardware resource\n");
   }
+  // Workers are assigned resources by their index across all domains
+  // (see perworkerid.hpp), so that, e.g., with dense packing, the
+  // workers of a pool come after those of the domains before it.
+  auto base = perworker::id::get_base();
+  auto assign = [&] (size_t worker_id, hwloc_cpuset_t cpuset) {
+    if (worker_id >= base) {
+      hwloc_cpusets[worker_id - base] = hwloc_bitmap_dup(cpuset);
+    }
+  };
   if (resource_packing == resource_packing_sparse) {
-    for (size_t worker_id = 0, object_id = 0; worker_id < nb_workers; worker_id++, object_id++) {
+    for (size_t worker_id = 0, object_id = 0; worker_id < base + nb_workers; worker_id++, object_id++) {
       object_id = (object_id >= nb_objects) ? 0 : object_id;
       //printf("nbo = %d depth = %d oid=%d wid=%d\n",nb_objects,depth,object_id, worker_id);
       auto cpuset = hwloc_get_obj_by_depth(topology, depth, object_id)->cpuset;
-      hwloc_cpusets[worker_id] = hwloc_bitmap_dup(cpuset);
+      assign(worker_id, cpuset);
     }
   } else if (resource_packing == resource_packing_dense) {
-    for (size_t worker_id = 0, object_id = 0, i = 0; worker_id < nb_workers; worker_id++) {
+    for (size_t worker_id = 0, object_id = 0, i = 0; worker_id < base + nb_workers; worker_id++) {
       object_id = (object_id >= nb_objects) ? 0 : object_id;
       auto cpuset = hwloc_get_obj_by_depth(topology, depth, object_id)->cpuset;
       auto nb_in_obj = hwloc_get_nbobjs_inside_cpuset_by_depth(topology, cpuset, depth + 1);
@@ -89,14 +99,24 @@ auto hwloc_assign_cpusets(size_t nb_workers,
 	i = 0;
 	object_id++;
       }
-      hwloc_cpusets[worker_id] = hwloc_bitmap_dup(cpuset);
+      assign(worker_id, cpuset);
     }
   } else {
     taskparts_die("impossible");
   }
 }
 
+// number of domains that use the topology, which is loaded only once
+// for all of them
+size_t nb_topology_users = 0;
+
+std::mutex topology_lock;
+
 auto initialize_hwloc(size_t nb_workers, bool numa_alloc_interleaved) {
+  std::lock_guard<std::mutex> lk(topology_lock);
+  if (nb_topology_users++ > 0) {
+    return;
+  }
   hwloc_topology_init(&topology);
   hwloc_topology_load(topology);
   if (numa_alloc_interleaved) {
@@ -109,6 +129,29 @@ auto initialize_hwloc(size_t nb_workers, bool numa_alloc_interleaved) {
   }
 }
 
+// Two workers share a level when their cpusets are both included in
+// the same hardware object of the type of the level.
+auto hwloc_assign_locality(size_t nb_workers) {
+  hwloc_obj_type types[] = { HWLOC_OBJ_L2CACHE, HWLOC_OBJ_L3CACHE, HWLOC_OBJ_NUMANODE };
+  std::vector<int> owners[locality_level_machine];
+  for (int l = 0; l < locality_level_machine; l++) {
+    owners[l].assign(nb_workers, -1);
+    int nb_objects = hwloc_get_nbobjs_by_type(topology, types[l]);
+    for (size_t id = 0; id < nb_workers; id++) {
+      for (int i = 0; i < nb_objects; i++) {
+        auto obj = hwloc_get_obj_by_type(topology, types[l], i);
+        if ((obj->cpuset != nullptr) && hwloc_bitmap_isincluded(hwloc_cpusets[id], obj->cpuset)) {
+          owners[l][id] = i;
+          break;
+        }
+      }
+    }
+  }
+  assign_locality(nb_workers, [&] (locality_level_type level, size_t i, size_t j) {
+    return (owners[level][i] != -1) && (owners[level][i] == owners[level][j]);
+  });
+}
+
 auto hwloc_pin_calling_worker() {
   if (pinning_policy == pinning_policy_disabled) {
     return;
@@ -175,20 +218,31 @@ auto posix_initialize_machine() {
     rb = HWLOC_OBJ_NUMANODE;
   }
   hwloc_assign_cpusets(nb_workers, pinning_policy, resource_packing, rb);
+  if (pinning_policy == pinning_policy_enabled) {
+    hwloc_assign_locality(nb_workers);
+    return;
+  }
 #else
   if (requested_pinning_policy) {
     taskparts_die("Requested pinning policy, but need hwloc to realize it");
   }
 #endif
+  // worker threads may run anywhere, so all of them are remote
+  assign_locality(nb_workers, [] (locality_level_type, size_t, size_t) {
+    return false;
+  });
 }
 
 auto posix_teardown_machine() {
 #ifdef TASKPARTS_HAVE_HWLOC
-  hwloc_bitmap_free(all_cpus);
   for (size_t id = 0; id != perworker::nb_workers(); ++id) {
     hwloc_bitmap_free(hwloc_cpusets[id]);
   }
-  hwloc_topology_destroy(topology);
+  std::lock_guard<std::mutex> lk(topology_lock);
+  if (--nb_topology_users == 0) {
+    hwloc_bitmap_free(all_cpus);
+    hwloc_topology_destroy(topology);
+  }
 #endif
 }
 
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdlib>
 #include <string>
+#include <mutex>
 #include <thread>
 #include <assert.h>
 
@@ -23,6 +24,22 @@ int default_max_nb_workers_lg = TASKPARTS_MAX_NB_WORKERS_LG;
 static constexpr
 int default_max_nb_workers = 1 << default_max_nb_workers_lg;
 
+/* Worker domains
+ *
+ * Worker ids are local to a domain, i.e., a set of workers that run
+ * one scheduler. Each domain owns a disjoint range [base, base +
+ * nb_workers) of the slots of every perworker::array, so that
+ * schedulers running side by side in different domains never share
+ * per-worker state. The default domain holds the workers of launch()
+ * (see nb_workers_requested()); worker pools reserve domains of their
+ * own (see pool.hpp). A thread belongs to the domain of the thread
+ * that launched it.
+ */
+using domain_type = struct domain_struct {
+  size_t base;
+  size_t nb_workers;
+};
+
 class id {
 private:
 
@@ -35,6 +52,19 @@ private:
   static thread_local
   int my_id;
 
+  static thread_local
+  int my_base;
+
+  // -1: the calling thread belongs to the default domain
+  static thread_local
+  int my_nb_workers;
+
+  static
+  std::mutex domains_lock;
+
+  static
+  bool reserved[default_max_nb_workers];
+
 public:
   
   static
@@ -48,6 +78,9 @@ public:
     }
     initialize_worker(0);
     nb_workers = (int)_nb_workers;
+    for (size_t i = 0; i < _nb_workers; i++) {
+      reserved[i] = true;
+    }
   }
 
   static
@@ -58,6 +91,11 @@ public:
     my_id = (int)id;
   }
 
+  static inline
+  auto is_worker() -> bool {
+    return my_id != uninitialized_id;
+  }
+
   static inline
   auto get_my_id() -> size_t {
     assert(my_id != uninitialized_id);
@@ -66,10 +104,61 @@ public:
 
   static inline
   auto get_nb_workers() -> size_t {
+    if (my_nb_workers != -1) {
+      return my_nb_workers;
+    }
     assert(nb_workers != -1);
     return nb_workers;
   }
 
+  static inline
+  auto get_base() -> size_t {
+    return (size_t)my_base;
+  }
+
+  static
+  auto get_domain() -> domain_type {
+    return { get_base(), get_nb_workers() };
+  }
+
+  // makes the calling thread join the given domain
+  static
+  auto enter_domain(domain_type d) -> void {
+    my_base = (int)d.base;
+    my_nb_workers = (d.base == 0) ? -1 : (int)d.nb_workers;
+  }
+
+  // reserves the first free range of nb_workers slots
+  static
+  auto reserve_domain(size_t _nb_workers) -> domain_type {
+    std::lock_guard<std::mutex> lk(domains_lock);
+    size_t base = 1;
+    while (base + _nb_workers <= default_max_nb_workers) {
+      size_t i = 0;
+      while ((i < _nb_workers) && ! reserved[base + i]) {
+        i++;
+      }
+      if (i == _nb_workers) {
+        for (i = 0; i < _nb_workers; i++) {
+          reserved[base + i] = true;
+        }
+        return { base, _nb_workers };
+      }
+      base += i + 1;
+    }
+    taskparts_die("Requested too many worker threads: %lld, the total over all domains should be maximum %lld\n",
+		  _nb_workers, default_max_nb_workers);
+    return { 0, 0 };
+  }
+
+  static
+  auto release_domain(domain_type d) -> void {
+    std::lock_guard<std::mutex> lk(domains_lock);
+    for (size_t i = 0; i < d.nb_workers; i++) {
+      reserved[d.base + i] = false;
+    }
+  }
+
 };
 
 int id::nb_workers = -1;
@@ -77,6 +166,16 @@ int id::nb_workers = -1;
 thread_local
 int id::my_id = uninitialized_id;
 
+thread_local
+int id::my_base = 0;
+
+thread_local
+int id::my_nb_workers = -1;
+
+std::mutex id::domains_lock;
+
+bool id::reserved[default_max_nb_workers];
+
 static
 auto nb_workers_requested() -> size_t {
 #ifndef TASKPARTS_SERIAL
@@ -101,6 +200,17 @@ auto my_id() -> size_t {
   return id::get_my_id();
 }
 
+static inline
+auto is_worker() -> bool {
+  return id::is_worker();
+}
+
+// index of the slot of the calling worker across all domains
+static
+auto my_global_id() -> size_t {
+  return id::get_base() + id::get_my_id();
+}
+
 static
 auto nb_workers() -> size_t {
   return id::get_nb_workers();
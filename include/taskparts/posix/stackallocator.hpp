@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "diagnostics.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Guard-paged call stacks */
+
+/* Each call stack is an anonymous mapping whose lowest page is a
+ * PROT_NONE guard page, so that a stack overflow faults instead of
+ * corrupting neighboring memory. The pages of the mapping are
+ * committed only when first touched.
+ */
+class mmap_stack_allocator {
+public:
+
+  static
+  auto page_szb() -> size_t {
+    static size_t szb = (size_t)sysconf(_SC_PAGESIZE);
+    return szb;
+  }
+
+  static
+  auto mapping_szb(size_t szb) -> size_t {
+    auto p = page_szb();
+    return p + ((szb + p - 1) / p) * p;
+  }
+
+  static
+  auto allocate(size_t szb, size_t) -> char* {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    auto m = mmap(nullptr, mapping_szb(szb), PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (m == MAP_FAILED) {
+      return nullptr;
+    }
+    if (mprotect(m, page_szb(), PROT_NONE) != 0) {
+      taskparts_die("failed to protect the guard page of a call stack\n");
+    }
+    return (char*)m + page_szb();
+  }
+
+  static
+  auto deallocate(char* p, size_t szb) {
+    munmap(p - page_szb(), mapping_szb(szb));
+  }
+
+};
+
+} // end namespace
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "diagnostics.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Append-only memory-mapped file */
+
+/* A file that grows by extents of extent_szb bytes, the last of which
+ * is mapped in memory, so that an append is a copy into the mapping.
+ * The file is truncated to the bytes actually appended when closed.
+ */
+class mmap_append_file {
+private:
+
+  static constexpr
+  size_t extent_szb = 64 * 1024 * 1024;
+
+  int fd = -1;
+
+  char* extent = nullptr;
+
+  // offset in the file of the mapped extent
+  size_t extent_offset = 0;
+
+  // number of bytes appended to the mapped extent
+  size_t extent_used = 0;
+
+  auto map_extent(size_t offset) {
+    if (ftruncate(fd, offset + extent_szb) != 0) {
+      die("mmap_append_file: ftruncate failed\n");
+    }
+    auto m = mmap(nullptr, extent_szb, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    if (m == MAP_FAILED) {
+      die("mmap_append_file: mmap failed\n");
+    }
+    extent = (char*)m;
+    extent_offset = offset;
+    extent_used = 0;
+  }
+
+  auto unmap_extent() {
+    if (extent != nullptr) {
+      munmap(extent, extent_szb);
+      extent = nullptr;
+    }
+  }
+
+public:
+
+  auto open(const char* path) -> bool {
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    map_extent(0);
+    return true;
+  }
+
+  auto is_open() const -> bool {
+    return fd >= 0;
+  }
+
+  auto append(const void* src, size_t szb) {
+    auto s = (const char*)src;
+    while (szb > 0) {
+      if (extent_used == extent_szb) {
+        unmap_extent();
+        map_extent(extent_offset + extent_szb);
+      }
+      auto n = std::min(szb, extent_szb - extent_used);
+      memcpy(extent + extent_used, s, n);
+      extent_used += n;
+      s += n;
+      szb -= n;
+    }
+  }
+
+  auto close() {
+    if (fd < 0) {
+      return;
+    }
+    unmap_extent();
+    if (ftruncate(fd, extent_offset + extent_used) != 0) {
+      die("mmap_append_file: ftruncate failed\n");
+    }
+    ::close(fd);
+    fd = -1;
+  }
+
+};
+
+} // end namespace
@@ -27,7 +27,10 @@ public:
     using counter_id_type = enum counter_id_enum {
       nb_fibers,
       nb_steals,
-#ifdef TASKPARTS_ELASTIC_WORKSTEALING
+      nb_stolen_fibers,
+      nb_steals_l2, nb_steals_l3, nb_steals_numa_node, nb_steals_machine,
+      nb_estimator_refreshes, nb_estimator_cas_failures,
+#if defined(TASKPARTS_ELASTIC_WORKSTEALING) || defined(TASKPARTS_PARK_IDLE_WORKERS)
       nb_sleeps, nb_surplus_transitions,
 #endif
       nb_counters
@@ -72,12 +75,15 @@ public:
   auto on_exit_sleep() { }
 
   static inline
-  auto increment(configuration_type::counter_id_type id) { }
+  auto increment(configuration_type::counter_id_type id, uint64_t n = 1) { }
 
   static inline
   auto on_new_fiber() {
     increment(configuration_type::nb_fibers);
   }
+
+  static inline
+  auto on_live_stacks(size_t) { }
   
 };
 
@@ -101,6 +107,9 @@ using event_tag_type = enum event_tag_type_enum {
   enter_sleep,        exit_sleep,     failed_to_sleep,
   wake_child,         worker_exit,    initiate_teardown,
   program_point,
+  fiber_create,       fiber_add_edge, fiber_release,
+  fiber_steal,        fiber_resume,
+  fiber_enter,        fiber_exit,
   nb_events
 };
 
@@ -121,6 +130,13 @@ auto name_of(event_tag_type e) -> std::string {
     case initiate_teardown: return "initiate_teardown";
     case algo_phase:        return "algo_phase ";
     case program_point:        return "program_point ";
+    case fiber_create:      return "fiber_create ";
+    case fiber_add_edge:    return "fiber_add_edge ";
+    case fiber_release:     return "fiber_release ";
+    case fiber_steal:       return "fiber_steal ";
+    case fiber_resume:      return "fiber_resume ";
+    case fiber_enter:       return "fiber_enter ";
+    case fiber_exit:        return "fiber_exit ";
     default:                return "unknown_event ";
   }
 }
@@ -142,6 +158,13 @@ auto kind_of(event_tag_type e) -> event_kind_type {
     case worker_exit:
     case initiate_teardown:
     case program_point:             return program;
+    case fiber_create:
+    case fiber_add_edge:
+    case fiber_release:
+    case fiber_enter:
+    case fiber_exit:                return fibers;
+    case fiber_steal:
+    case fiber_resume:              return migration;
     default:                        return nb_kinds;
   }
 }
@@ -158,6 +181,9 @@ public:
   static
   auto output(std::string) { }
 
+  static
+  auto teardown() { }
+
   static inline
   auto log_event(event_tag_type tag) { }
 
@@ -170,6 +196,9 @@ public:
   static inline
   auto log_program_point(int line_nb, const char* source_fname, void* ptr) { }
 
+  static inline
+  auto log_fiber_event(event_tag_type tag, void* f, void* g, size_t id) { }
+
 };
 
 /*---------------------------------------------------------------------*/
@@ -207,7 +236,9 @@ public:
   template <typename Body>
   static
   auto launch_worker_thread(size_t id, const Body& b) {
-    minimal_launch_worker_thread(id, [id, &b] {
+    auto d = perworker::id::get_domain();
+    minimal_launch_worker_thread(id, [id, d, &b] {
+      perworker::id::enter_domain(d);
       perworker::id::initialize_worker(id);
       pin_calling_worker();
       b(id);
@@ -230,6 +261,12 @@ public:
   static constexpr
   bool override_rand_worker = false;
 
+  static constexpr
+  bool needs_surplus = false;
+
+  static constexpr
+  bool notify_on_unknown_surplus = false;
+
   static
   auto try_to_sleep(size_t) {
     worker_yield();
@@ -267,14 +304,137 @@ public:
   auto exists_imbalance() -> bool {
     return false;
   }
+
+  static
+  auto on_termination() { }
+
+  // called after a thread, possibly not a worker, injects a fiber
+  static
+  auto on_inject() { }
   
 };
 
+/*---------------------------------------------------------------------*/
+/* Work-stealing deques */
+
 using deque_surplus_result_type = enum deque_surplus_result_enum {
   deque_surplus_stable, deque_surplus_up, deque_surplus_down,
   deque_surplus_unknown
 };
 
+/* The work-stealing scheduler takes its deque as a template
+ * parameter, Deque, which it instantiates as Deque<Fiber>. A deque
+ * class must be default constructible and provide the following
+ * members.
+ *
+ *   static constexpr bool reports_surplus;
+ *     true iff the deque reports transitions of its size between
+ *     zero and nonzero (i.e., it never returns deque_surplus_unknown)
+ *
+ *   auto push(Fiber* f) -> deque_surplus_result_type;
+ *     called by the owner only; returns deque_surplus_up if the
+ *     deque was empty before the push (a deque that does not report
+ *     surplus may report it on push only, as seen by the owner,
+ *     which may miss a steal that raced with the push)
+ *
+ *   auto pop() -> std::pair<Fiber*, deque_surplus_result_type>;
+ *     called by the owner only; returns nullptr if the deque is
+ *     empty or if the last item was taken by a thief, and
+ *     deque_surplus_down if the deque became empty
+ *
+ *   auto steal() -> std::pair<Fiber*, deque_surplus_result_type>;
+ *     may be called by any worker; returns nullptr if the deque is
+ *     empty or if the steal lost a race, and deque_surplus_down if
+ *     the deque became empty
+ *
+ *   auto steal_batch(Fiber** dst, size_t max)
+ *     -> std::pair<size_t, deque_surplus_result_type>;
+ *     may be called by any worker; steals at least one and up to
+ *     half of the items, but no more than max, writing them oldest
+ *     first to dst, and returns the number of items stolen
+ *
+ *   auto size() -> <integral>;
+ *   auto empty() -> bool;
+ *     may be called by any worker; the result may be stale
+ *
+ * The default deque can be selected by one of the compiler flags
+ * TASKPARTS_USE_CHASELEV_DEQUE, TASKPARTS_USE_YWRA_DEQUE,
+ * TASKPARTS_USE_ABP_GROWABLE_DEQUE, or
+ * TASKPARTS_USE_YWRA_GROWABLE_DEQUE (the deque from Arora, Blumofe,
+ * and Plaxton is the default otherwise).
+ * Elastic work stealing requires a deque that reports surplus.
+ *
+ * Each of the deques above also takes a layout policy, Layout, that
+ * determines the alignment of its item slots and of its index words
+ * (e.g., top, bottom, and age). The padded layout (the default)
+ * puts every slot in its own 64-byte block, whereas the compact
+ * layout packs slots densely and pads only the index words. The
+ * compiler flag TASKPARTS_USE_COMPACT_DEQUE_LAYOUT selects the
+ * compact layout by default. The footprint_szb() method of a deque
+ * returns the number of bytes it occupies, including the arrays it
+ * allocated on the heap.
+ */
+
+class deque_layout_padded {
+public:
+
+  static constexpr
+  size_t slot_align_szb = 64;
+
+  static constexpr
+  size_t index_align_szb = alignof(int64_t);
+
+};
+
+class deque_layout_compact {
+public:
+
+  static constexpr
+  size_t slot_align_szb = alignof(void*);
+
+  static constexpr
+  size_t index_align_szb = TASKPARTS_CACHE_LINE_SZB;
+
+};
+
+#ifdef TASKPARTS_USE_COMPACT_DEQUE_LAYOUT
+using dflt_deque_layout = deque_layout_compact;
+#else
+using dflt_deque_layout = deque_layout_padded;
+#endif
+
+template <typename Fiber, typename Layout=dflt_deque_layout>
+struct abp;
+
+template <typename Fiber, typename Layout=dflt_deque_layout>
+class chaselev;
+
+template <typename Fiber, typename Layout=dflt_deque_layout>
+struct ywra;
+
+template <typename Fiber, typename Layout=dflt_deque_layout>
+struct abp_growable;
+
+template <typename Fiber, typename Layout=dflt_deque_layout>
+struct ywra_growable;
+
+#if defined(TASKPARTS_USE_YWRA_GROWABLE_DEQUE)
+template <typename Fiber>
+using dflt_deque = ywra_growable<Fiber>;
+#elif defined(TASKPARTS_ELASTIC_WORKSTEALING) || defined(TASKPARTS_USE_YWRA_DEQUE)
+template <typename Fiber>
+using dflt_deque = ywra<Fiber>;
+#elif defined(TASKPARTS_USE_CHASELEV_DEQUE)
+template <typename Fiber>
+using dflt_deque = chaselev<Fiber>;
+#elif defined(TASKPARTS_USE_ABP_GROWABLE_DEQUE)
+template <typename Fiber>
+using dflt_deque = abp_growable<Fiber>;
+#else
+template <typename Fiber>
+using dflt_deque = abp<Fiber>;
+#endif
+
 /*---------------------------------------------------------------------*/
 /* Interrupts */
 
@@ -292,6 +452,13 @@ public:
 
 };
 
+/*---------------------------------------------------------------------*/
+/* Victim selection (see victimselection.hpp) */
+
+class dynamic_victim_selection;
+
+using dflt_victim_selection = dynamic_victim_selection;
+
 /*---------------------------------------------------------------------*/
 /* Schedulers */
 
@@ -299,45 +466,73 @@ template <typename Scheduler,
           template <typename> typename Fiber,
           typename Stats, typename Logging,
           typename Worker,
-          typename Interrupt>
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
 void schedule(Fiber<Scheduler>* f);
 
 template <typename Scheduler,
 	  template <typename> typename Fiber,
 	  typename Stats, typename Logging,
 	  typename Worker,
-	  typename Interrupt>
+	  typename Interrupt,
+	  template <typename> typename Deque,
+	  typename Victim_selection>
 Fiber<Scheduler>* take();
 
 template <typename Scheduler,
 	  template <typename> typename Fiber,
 	  typename Stats, typename Logging,
 	  typename Worker,
-	  typename Interrupt>
+	  typename Interrupt,
+	  template <typename> typename Deque,
+	  typename Victim_selection>
 void commit();
 
+template <typename Scheduler,
+	  template <typename> typename Fiber,
+	  typename Stats, typename Logging,
+	  typename Worker,
+	  typename Interrupt,
+	  template <typename> typename Deque,
+	  typename Victim_selection>
+bool is_deque_empty();
+
+// The Tag parameter makes distinct types of otherwise identical
+// schedulers, so that schedulers running side by side (e.g., those of
+// distinct worker pools) have distinct static state.
 template <typename Stats=minimal_stats, typename Logging=minimal_logging,
 	  typename Worker=minimal_worker,
-	  typename Interrupt=minimal_interrupt>
+	  typename Interrupt=minimal_interrupt,
+	  template <typename> typename Deque=dflt_deque,
+	  typename Victim_selection=dflt_victim_selection,
+	  typename Tag=void>
 class minimal_scheduler {
 public:
 
   template <template <typename> typename Fiber>
   static
   void schedule(Fiber<minimal_scheduler>* f) {
-    taskparts::schedule<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt>(f);
+    taskparts::schedule<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt, Deque, Victim_selection>(f);
   }
 
   template <template <typename> typename Fiber>
   static
   Fiber<minimal_scheduler>* take() {
-    return taskparts::take<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt>();
+    return taskparts::take<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt, Deque, Victim_selection>();
   }
 
   template <template <typename> typename Fiber>
   static
   void commit(Fiber<minimal_scheduler>*) {
-    taskparts::commit<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt>();
+    taskparts::commit<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt, Deque, Victim_selection>();
+  }
+
+  // true iff the deque of the calling worker is empty
+  template <template <typename> typename Fiber>
+  static
+  bool is_deque_empty() {
+    return taskparts::is_deque_empty<minimal_scheduler, Fiber, Stats, Logging, Worker, Interrupt, Deque, Victim_selection>();
   }
 
   static inline
@@ -345,10 +540,25 @@ public:
     Stats::on_new_fiber();
   }
 
+  static inline
+  auto on_live_stacks(size_t nb_live) {
+    Stats::on_live_stacks(nb_live);
+  }
+
   static inline
   auto log_program_point(int line_nb, const char* source_fname, void* ptr) {
     Logging::log_program_point(line_nb, source_fname, ptr);
   }
+
+  // f is the fiber of the event; g is the other fiber, if any (the
+  // target of an edge, or the predecessor that released f); id is a
+  // worker, if any (the victim of a steal, or the worker that last
+  // ran f before a resume), or the status returned by the exec() of f
+  // (for fiber_exit)
+  static inline
+  auto log_fiber_event(event_tag_type tag, void* f, void* g=nullptr, size_t id=0) {
+    Logging::log_fiber_event(tag, f, g, id);
+  }
   
 };
 
@@ -372,6 +582,7 @@ public:
 
   minimal_fiber() {
     Scheduler::on_new_fiber();
+    Scheduler::log_fiber_event(fiber_create, this);
   }
 
   virtual
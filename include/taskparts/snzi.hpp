@@ -122,7 +122,7 @@ public:
     return parent;
   }
 
-  auto increment() {
+  auto increment() -> void {
     snzi_increment(*this);
   }
 
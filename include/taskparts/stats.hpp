@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdio>
+#include <vector>
+#include <algorithm>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -32,6 +34,7 @@ public:
     double utilization;
     rusage_type rusage_before;
     rusage_type rusage_after;
+    std::vector<uint64_t> max_live_stacks; // per worker
   };
   
 private:
@@ -71,17 +74,21 @@ private:
   static
   perworker::array<private_timers> all_timers;
 
+  // high-water mark of the number of call stacks in use
+  static
+  perworker::array<uint64_t> all_max_live_stacks;
+
   static
   std::vector<summary_type> summaries;
 
 public:
 
   static inline
-  auto increment(counter_id_type id) {
+  auto increment(counter_id_type id, uint64_t n = 1) {
     if (! Configuration::collect_all_stats) {
       return;
     }
-    all_counters.mine().counters[id]++;
+    all_counters.mine().counters[id] += n;
   }
 
   static inline
@@ -89,6 +96,15 @@ public:
     increment(Configuration::nb_fibers);
   }
 
+  static inline
+  auto on_live_stacks(size_t nb_live) {
+    if (! Configuration::collect_all_stats) {
+      return;
+    }
+    auto& m = all_max_live_stacks.mine();
+    m = std::max(m, (uint64_t)nb_live);
+  }
+
   static
   auto on_enter_acquire() {
     if (! Configuration::collect_all_stats) {
@@ -145,12 +161,12 @@ public:
   auto start_collecting() {
     getrusage(RUSAGE_SELF, &ru_launch_time);
     enter_launch_time = steadyclock::now();
-    for (int i = 0; i < all_counters.size(); i++) {
+    for (size_t i = 0; i < perworker::nb_workers(); i++) {
       for (int j = 0; j < Configuration::nb_counters; j++) {
         all_counters[i].counters[j] = 0;
       }
     }
-    for (int i = 0; i < all_timers.size(); i++) {
+    for (size_t i = 0; i < perworker::nb_workers(); i++) {
       auto& t = all_timers[i];
       t.start_work = now();
       t.total_work_time = 0;
@@ -159,6 +175,9 @@ public:
       t.start_sleep = now();
       t.total_sleep_time = 0;
     }
+    for (size_t i = 0; i < perworker::nb_workers(); i++) {
+      all_max_live_stacks[i] = 0;
+    }
   }
 
   static
@@ -178,6 +197,9 @@ public:
       }
       summary.counters[counter_id] = counter_value;
     }
+    for (size_t i = 0; i < nb_workers; ++i) {
+      summary.max_live_stacks.push_back(all_max_live_stacks[i]);
+    }
     double cumulated_time = summary.exectime * nb_workers;
     timestamp_type total_work_time = 0;
     timestamp_type total_idle_time = 0;
@@ -249,6 +271,13 @@ public:
     for (int i = 0; i < Configuration::nb_counters; i++) {
       output_uint64_value(Configuration::name_of_counter((counter_id_type)i), summary.counters[i]);
     }
+    auto& mls = summary.max_live_stacks;
+    output_uint64_value("max_live_stacks", mls.empty() ? 0 : *std::max_element(mls.begin(), mls.end()));
+    fprintf(f, "\"max_live_stacks_per_worker\": [");
+    for (size_t i = 0; i < mls.size(); i++) {
+      fprintf(f, "%lu%s", (unsigned long)mls[i], (i + 1 == mls.size()) ? "" : ", ");
+    }
+    fprintf(f, "],\n");
     output_cycles_in_seconds("total_work_time", summary.total_work_time);
     output_cycles_in_seconds("total_idle_time", summary.total_idle_time);
     output_cycles_in_seconds("total_sleep_time", summary.total_sleep_time);
@@ -299,4 +328,7 @@ steadyclock::time_point_type stats_base<Configuration>::enter_launch_time;
 template <typename Configuration>
 perworker::array<typename stats_base<Configuration>::private_timers> stats_base<Configuration>::all_timers;
 
+template <typename Configuration>
+perworker::array<uint64_t> stats_base<Configuration>::all_max_live_stacks;
+
 } // end namespace
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <assert.h>
+
+#include "fiber.hpp"
+#include "nativeforkjoin.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Fibers with many successors */
+
+/* A fiber that, in addition to its out-edge, has a list of successors,
+ * each of which it releases when it finishes. Edges to successors are
+ * added by add_successor(), and are counted in the in-counters of the
+ * successors just like out-edges are. The class takes its base class,
+ * Base, as a parameter, so that, e.g., native fork-join fibers can have
+ * successors too.
+ *
+ * A fiber notifies its successors before its out-edge, and touches
+ * none of its own fields after the last release, because the last
+ * release may lead to the destruction of the fiber by another worker
+ * (e.g., at the end of task_graph::run()).
+ */
+template <typename Scheduler=minimal_scheduler<>, typename Base=fiber<Scheduler>>
+class dataflow_fiber : public Base {
+public:
+
+  std::vector<fiber<Scheduler>*> successors;
+
+  dataflow_fiber() : Base() { }
+
+  static
+  auto add_successor(dataflow_fiber* src, fiber<Scheduler>* dst) {
+    src->successors.push_back(dst);
+    fiber<Scheduler>::incr_incounter(src, dst);
+  }
+
+  void notify() override {
+    assert(Base::is_ready());
+    auto ss = std::move(successors);
+    successors.clear();
+    auto fo = fiber<Scheduler>::outedge;
+    fiber<Scheduler>::outedge = nullptr;
+    for (auto f : ss) {
+      f->release(this);
+    }
+    if (fo != nullptr) {
+      fo->release(this);
+    }
+  }
+
+};
+
+/*---------------------------------------------------------------------*/
+/* Task graphs */
+
+/* A task graph is a DAG whose nodes are functions of no arguments and
+ * whose edges are dependencies between them, e.g.,
+ *
+ *   task_graph<Scheduler> g;
+ *   auto a = g.add_node([&] { ... });
+ *   auto b = g.add_node([&] { ... });
+ *   g.add_edge(a, b); // b runs after a finishes
+ *   g.run();
+ *
+ * The caller declares the whole graph, and then calls run() (once)
+ * from a native fork-join fiber, e.g., from the body of launch() or of
+ * a fork2join() branch. run() returns after all nodes have finished.
+ * Each node runs as a native fork-join fiber, so the body of a node may
+ * itself call fork2join() and the like. A node becomes ready when all
+ * of its predecessors have finished, as counted by the usual in-counters
+ * of fibers, and so wavefront and pipeline computations can proceed
+ * without the barriers of bulk-synchronous phases.
+ */
+template <typename Scheduler=minimal_scheduler<>>
+class task_graph {
+public:
+
+  using node_type = size_t;
+
+private:
+
+  class node_fiber : public dataflow_fiber<Scheduler, nativefj_fiber<Scheduler>> {
+  public:
+
+    std::function<void()> body;
+
+#ifdef TASKPARTS_WORKSPAN
+    task_graph* graph;
+
+    // span, since the start of run(), at which all the predecessors of
+    // this node have finished
+    std::atomic<uint64_t> ws_start_span;
+
+    workspan_type ws;
+#endif
+
+    node_fiber(std::function<void()> body)
+      : dataflow_fiber<Scheduler, nativefj_fiber<Scheduler>>(), body(std::move(body)) {
+#ifdef TASKPARTS_WORKSPAN
+      ws_start_span.store(0);
+#endif
+    }
+
+    void run2() {
+#ifdef TASKPARTS_WORKSPAN
+      ws = workspan_run(graph->ws_site, body);
+#else
+      body();
+#endif
+    }
+
+    // the graph owns its nodes
+    void finish() {
+#ifdef TASKPARTS_WORKSPAN
+      // before the releases, which make these writes visible to the
+      // successors and to the caller of run()
+      auto s = ws_start_span.load() + ws.span;
+      for (auto f : this->successors) {
+        workspan_max(static_cast<node_fiber*>(f)->ws_start_span, s);
+      }
+      graph->ws_work += ws.work;
+      workspan_max(graph->ws_span, s);
+#endif
+      this->notify();
+    }
+
+  };
+
+  // a fiber with an edge from each node that has no successors
+  class sink_fiber : public fiber<Scheduler> {
+  public:
+
+    auto run() -> fiber_status_type {
+      return fiber_status_finish;
+    }
+
+    void finish() {
+      fiber<Scheduler>::notify();
+    }
+
+  };
+
+  std::vector<std::unique_ptr<node_fiber>> nodes;
+
+  bool ran = false;
+
+#ifdef TASKPARTS_WORKSPAN
+  // work of all the nodes, and span of the longest path of nodes
+  std::atomic<uint64_t> ws_work, ws_span;
+
+  workspan_site* ws_site = nullptr;
+#endif
+
+public:
+
+  task_graph(Scheduler sched=Scheduler()) {
+#ifdef TASKPARTS_WORKSPAN
+    ws_work.store(0);
+    ws_span.store(0);
+#endif
+  }
+
+  task_graph(const task_graph&) = delete;
+
+  template <typename F>
+  auto add_node(const F& f) -> node_type {
+    assert(! ran);
+    nodes.emplace_back(new node_fiber(f));
+#ifdef TASKPARTS_WORKSPAN
+    nodes.back()->graph = this;
+#endif
+    return nodes.size() - 1;
+  }
+
+  // src must finish before dst starts
+  auto add_edge(node_type src, node_type dst) {
+    assert(! ran);
+    assert((src < nodes.size()) && (dst < nodes.size()));
+    dataflow_fiber<Scheduler, nativefj_fiber<Scheduler>>::add_successor(nodes[src].get(), nodes[dst].get());
+  }
+
+  auto nb_nodes() const -> size_t {
+    return nodes.size();
+  }
+
+  auto run() {
+    assert(! ran);
+    ran = true;
+    if (nodes.empty()) {
+      return;
+    }
+#ifdef TASKPARTS_WORKSPAN
+    {
+      auto w = workspan_suspend();
+      ws_site = w.site;
+      workspan_resume(w);
+    }
+#endif
+    sink_fiber sink;
+    for (auto& n : nodes) {
+      if (n->successors.empty()) {
+        fiber<Scheduler>::add_edge(n.get(), &sink);
+      }
+    }
+    // the nodes with no predecessors are ready as of here
+    for (auto& n : nodes) {
+      n->release();
+    }
+    nativefj_fiber<Scheduler>::fork1join(&sink);
+#ifdef TASKPARTS_WORKSPAN
+    auto w = workspan_suspend();
+    w.work += ws_work.load();
+    w.span += ws_span.load();
+    workspan_resume(w);
+#endif
+  }
+
+};
+
+} // end namespace
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <assert.h>
+
+#include "perworker.hpp"
+#include "hash.hpp"
+#include "machine.hpp"
+#include "diagnostics.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Victim selection for work stealing */
+
+/* The work-stealing scheduler takes its victim-selection policy as a
+ * template parameter, Victim_selection. A policy picks the target of
+ * each steal attempt of a thief and is notified of the outcome of
+ * the attempt. It provides the following static members.
+ *
+ *   auto initialize(size_t nb_workers);
+ *     called once by each launch of the scheduler, before the
+ *     workers start
+ *
+ *   auto select(size_t my_id, const Size_of& size_of) -> size_t;
+ *     returns a worker other than my_id; size_of(id) returns a
+ *     (possibly stale) size of the deque of worker id
+ *
+ *   auto on_steal(size_t my_id, size_t target_id, bool success);
+ *     called after each steal attempt
+ */
+
+// Picks victims uniformly at random
+class uniform_victim_selection {
+public:
+
+  static
+  auto initialize(size_t) { }
+
+  template <typename Size_of>
+  static inline
+  auto select(size_t my_id, const Size_of&) -> size_t {
+    return random_other_worker(my_id);
+  }
+
+  static inline
+  auto on_steal(size_t, size_t, bool) { }
+
+};
+
+// Retries the last victim from which the thief stole successfully
+// until a steal from it fails
+perworker::array<int> last_victims;
+
+class last_victim_selection {
+public:
+
+  static
+  auto initialize(size_t nb_workers) {
+    for (size_t i = 0; i < nb_workers; i++) {
+      last_victims[i] = -1;
+    }
+  }
+
+  template <typename Size_of>
+  static inline
+  auto select(size_t my_id, const Size_of&) -> size_t {
+    auto v = last_victims[my_id];
+    return (v == -1) ? random_other_worker(my_id) : (size_t)v;
+  }
+
+  static inline
+  auto on_steal(size_t my_id, size_t target_id, bool success) {
+    last_victims[my_id] = success ? (int)target_id : -1;
+  }
+
+};
+
+// Picks two victims uniformly at random and targets the one with the
+// larger deque
+class two_choices_victim_selection {
+public:
+
+  static
+  auto initialize(size_t) { }
+
+  template <typename Size_of>
+  static inline
+  auto select(size_t my_id, const Size_of& size_of) -> size_t {
+    auto v1 = random_other_worker(my_id);
+    auto v2 = random_other_worker(my_id);
+    return (size_of(v2) > size_of(v1)) ? v2 : v1;
+  }
+
+  static inline
+  auto on_steal(size_t, size_t, bool) { }
+
+};
+
+// Cycles through the other workers, starting from the successor of
+// the thief
+perworker::array<size_t> next_victims;
+
+class round_robin_victim_selection {
+public:
+
+  static
+  auto initialize(size_t nb_workers) {
+    for (size_t i = 0; i < nb_workers; i++) {
+      next_victims[i] = i;
+    }
+  }
+
+  template <typename Size_of>
+  static inline
+  auto select(size_t my_id, const Size_of&) -> size_t {
+    auto nb_workers = perworker::nb_workers();
+    assert(nb_workers > 1);
+    auto& v = next_victims[my_id];
+    v = (v + 1) % nb_workers;
+    if (v == my_id) {
+      v = (v + 1) % nb_workers;
+    }
+    return v;
+  }
+
+  static inline
+  auto on_steal(size_t, size_t, bool) { }
+
+};
+
+/* Locality-aware victim selection: a thief first probes the workers
+ * that share its L2 cache, then those that share its L3 cache, then
+ * its NUMA node, and finally all workers of the machine. The thief
+ * moves to the next level after a number of consecutive failed
+ * steals at the current one (by default, the number of workers at
+ * that level), and returns to the nearest level after any successful
+ * steal. Without locality information, the policy degrades to
+ * uniform victim selection.
+ */
+
+using locality_victim_state_type = struct locality_victim_state_struct {
+  int level;
+  size_t nb_failures;
+};
+
+perworker::array<locality_victim_state_type> locality_victim_states;
+
+namespace {
+size_t nb_local_steal_attempts = 0; // 0: number of workers at the level
+}
+
+class locality_victim_selection {
+public:
+
+  static
+  auto initialize(size_t nb_workers) {
+    if (const auto env_p = std::getenv("TASKPARTS_NB_LOCAL_STEAL_ATTEMPTS")) {
+      nb_local_steal_attempts = std::max(0, std::stoi(env_p));
+    }
+    for (size_t i = 0; i < nb_workers; i++) {
+      locality_victim_states[i] = { locality_level_l2, 0 };
+    }
+  }
+
+  template <typename Size_of>
+  static inline
+  auto select(size_t my_id, const Size_of&) -> size_t {
+    auto& s = locality_victim_states[my_id];
+    auto& neighbors = locality_neighbors[my_id];
+    while ((s.level < locality_level_machine) && neighbors[s.level].empty()) {
+      s.level++;
+    }
+    auto& ns = neighbors[s.level];
+    if (ns.empty()) {
+      return random_other_worker(my_id);
+    }
+    return ns[random_number(my_id) % ns.size()];
+  }
+
+  static inline
+  auto on_steal(size_t my_id, size_t, bool success) {
+    auto& s = locality_victim_states[my_id];
+    if (success) {
+      s.level = locality_level_l2;
+      s.nb_failures = 0;
+      return;
+    }
+    if (s.level == locality_level_machine) {
+      return;
+    }
+    auto n = (nb_local_steal_attempts == 0) ? locality_neighbors[my_id][s.level].size() : nb_local_steal_attempts;
+    if (++s.nb_failures >= n) {
+      s.level++;
+      s.nb_failures = 0;
+    }
+  }
+
+};
+
+/*---------------------------------------------------------------------*/
+/* Run-time selection of the policy */
+
+using victim_selection_type = enum victim_selection_enum {
+  victim_selection_uniform,
+  victim_selection_last_victim,
+  victim_selection_two_choices,
+  victim_selection_round_robin,
+  victim_selection_locality
+};
+
+namespace {
+victim_selection_type victim_selection = victim_selection_uniform;
+}
+
+// Dispatches to the policy named by the environment variable
+// TASKPARTS_VICTIM_SELECTION (uniform by default)
+class dynamic_victim_selection {
+public:
+
+  static
+  auto initialize(size_t nb_workers) {
+    victim_selection = victim_selection_uniform;
+    if (const auto env_p = std::getenv("TASKPARTS_VICTIM_SELECTION")) {
+      auto s = std::string(env_p);
+      if (s == "last_victim") {
+        victim_selection = victim_selection_last_victim;
+      } else if (s == "two_choices") {
+        victim_selection = victim_selection_two_choices;
+      } else if (s == "round_robin") {
+        victim_selection = victim_selection_round_robin;
+      } else if (s == "locality") {
+        victim_selection = victim_selection_locality;
+      } else if (s != "uniform") {
+        taskparts_die("Bogus setting for environment variable TASKPARTS_VICTIM_SELECTION");
+      }
+    }
+    switch (victim_selection) {
+      case victim_selection_last_victim: last_victim_selection::initialize(nb_workers); break;
+      case victim_selection_round_robin: round_robin_victim_selection::initialize(nb_workers); break;
+      case victim_selection_locality: locality_victim_selection::initialize(nb_workers); break;
+      default: break;
+    }
+  }
+
+  template <typename Size_of>
+  static inline
+  auto select(size_t my_id, const Size_of& size_of) -> size_t {
+    switch (victim_selection) {
+      case victim_selection_last_victim: return last_victim_selection::select(my_id, size_of);
+      case victim_selection_two_choices: return two_choices_victim_selection::select(my_id, size_of);
+      case victim_selection_round_robin: return round_robin_victim_selection::select(my_id, size_of);
+      case victim_selection_locality: return locality_victim_selection::select(my_id, size_of);
+      default: return uniform_victim_selection::select(my_id, size_of);
+    }
+  }
+
+  static inline
+  auto on_steal(size_t my_id, size_t target_id, bool success) {
+    switch (victim_selection) {
+      case victim_selection_last_victim: last_victim_selection::on_steal(my_id, target_id, success); break;
+      case victim_selection_locality: locality_victim_selection::on_steal(my_id, target_id, success); break;
+      default: break;
+    }
+  }
+
+};
+
+} // end namespace
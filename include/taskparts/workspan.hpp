@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+#include "perworker.hpp"
+#include "timing.hpp"
+
+namespace taskparts {
+
+/*---------------------------------------------------------------------*/
+/* Work and span profiling */
+
+/* With the compiler flag TASKPARTS_WORKSPAN, fork2join() and lazy
+ * futures (see nativeforkjoin.hpp) measure the work (total cycles) and
+ * the span (cycles along the longest path) of the series-parallel
+ * computation that they build, in the manner of Cilkscale. Each worker
+ * times the strand that it runs, i.e., the code between two fork or
+ * join points, and adds the cycles of the strand to the work and the
+ * span of the computation so far. At a fork, the parent saves its work
+ * and span on its stack, and each branch starts from zero; at the
+ * join, the parent adds the work of both branches and the longer of
+ * their spans. Time spent in the scheduler, e.g., to steal, is not
+ * counted. A fork1join() ends the strand of its caller, which resumes
+ * with the same work and span once the forked fiber finishes; the
+ * forked fiber itself is not timed, because it may be any fiber, except
+ * for the nodes of a task graph (see taskgraph.hpp), whose work and span
+ * task_graph::run() adds to that of its caller.
+ *
+ * A workspan_site accumulates the work and span of the runs of a
+ * region, e.g., of a spguard() call site (see oracleguided.hpp).
+ */
+
+class workspan_site;
+
+using workspan_type = struct workspan_struct {
+  uint64_t work;
+  uint64_t span;
+  // innermost site that encloses the computation, if any
+  workspan_site* site;
+};
+
+class workspan_site {
+public:
+
+  std::atomic<uint64_t> work;
+
+  std::atomic<uint64_t> span;
+
+  std::atomic<uint64_t> nb_runs;
+
+  workspan_site() : work(0), span(0), nb_runs(0) { }
+
+  auto report(const workspan_type& w) {
+    work += w.work;
+    span += w.span;
+    nb_runs++;
+  }
+
+  auto reset() {
+    work.store(0);
+    span.store(0);
+    nb_runs.store(0);
+  }
+
+};
+
+perworker::array<workspan_type> workspan_current(workspan_type{0, 0, nullptr});
+
+// start time of the strand of each worker
+perworker::array<uint64_t> workspan_timer(0);
+
+// ends the strand of the calling worker, returning the work and span
+// of its computation so far
+static inline
+auto workspan_suspend() -> workspan_type {
+  auto& c = workspan_current.mine();
+  auto d = cycles::now() - workspan_timer.mine();
+  c.work += d;
+  c.span += d;
+  return c;
+}
+
+// starts a strand on the calling worker, in a computation of work and
+// span so far w
+static inline
+auto workspan_resume(const workspan_type& w) {
+  workspan_current.mine() = w;
+  workspan_timer.mine() = cycles::now();
+}
+
+// runs f as a computation of its own, in site, and returns its work
+// and span
+template <typename F>
+auto workspan_run(workspan_site* site, const F& f) -> workspan_type {
+  workspan_resume(workspan_type{0, 0, site});
+  f();
+  return workspan_suspend();
+}
+
+// raises a to v if v is greater
+static inline
+auto workspan_max(std::atomic<uint64_t>& a, uint64_t v) {
+  auto x = a.load();
+  while ((x < v) && ! a.compare_exchange_weak(x, v)) { }
+}
+
+// returns the work and span of w followed by the parallel composition
+// of w1 and w2
+static inline
+auto workspan_join(workspan_type w, const workspan_type& w1, const workspan_type& w2) -> workspan_type {
+  w.work += w1.work + w2.work;
+  w.span += std::max(w1.span, w2.span);
+  return w;
+}
+
+} // end namespace
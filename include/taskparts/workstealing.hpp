@@ -2,55 +2,43 @@
 
 #include <atomic>
 #include <memory>
+#include <thread>
 #include <assert.h>
 
 #include "fixedcapacity.hpp"
 #include "scheduler.hpp"
 #include "hash.hpp"
-// Configuration of deque data structure (assuming non-elastic
-// work stealing).
-#ifndef TASKPARTS_ELASTIC_WORKSTEALING
-namespace taskparts {
-template <typename Stats, typename Logging>
-using Elastic = minimal_elastic<Stats, Logging>;
-}
-#if defined(TASKPARTS_USE_CHASELEV_DEQUE)
+#include "abp.hpp"
 #include "chaselev.hpp"
-namespace taskparts {
-template <typename Fiber>
-using deque = chaselev<Fiber>;
-}
-#elif defined(TASKPARTS_USE_YWRA_DEQUE)
 #include "ywra.hpp"
+#include "victimselection.hpp"
+#include "mpmcqueue.hpp"
+// Configuration of the elastic work-stealing policy (by default,
+// non-elastic work stealing, in which idle workers park only with
+// TASKPARTS_PARK_IDLE_WORKERS). The Tag parameter separates the state
+// of schedulers that run side by side (see pool.hpp).
+#if ! defined(TASKPARTS_ELASTIC_WORKSTEALING) && ! defined(TASKPARTS_PARK_IDLE_WORKERS)
 namespace taskparts {
-template <typename Fiber>
-using deque = ywra<Fiber>;
+template <typename Stats, typename Logging, typename Tag=void>
+using Elastic = minimal_elastic<Stats, Logging>;
 }
-#else
-#include "abp.hpp"
+#elif ! defined(TASKPARTS_ELASTIC_WORKSTEALING)
+#include "parking.hpp"
 namespace taskparts {
-template <typename Fiber>
-using deque = abp<Fiber>;
+template <typename Stats, typename Logging, typename Tag=void>
+using Elastic = parking<Stats, Logging, Tag>;
 }
-#endif
 #else
-// Configuration of deque data structure and the elastic
-// work-stealing policy.
-#include "ywra.hpp" // <- the only deque structure compatible w/ elastic
 #include "fiber.hpp"
-namespace taskparts {
-template <typename Fiber>
-using deque = ywra<Fiber>;
-}
 #if defined(TASKPARTS_ELASTIC_TREE)
 namespace taskparts {
-template <typename Stats, typename Logging>
-using Elastic = elastic<Stats, Logging>;
+template <typename Stats, typename Logging, typename Tag=void>
+using Elastic = elastic<Stats, Logging, dflt_semaphore, perworker::default_max_nb_workers_lg, Tag>;
 }
 #elif defined(TASKPARTS_ELASTIC_S3)
 namespace taskparts {
-template <typename Stats, typename Logging>
-using Elastic = elastic_s3<Stats, Logging>;
+template <typename Stats, typename Logging, typename Tag=void>
+using Elastic = elastic_s3<Stats, Logging, dflt_semaphore, Tag>;
 }
 #else
 #error "Need to declare one of the elastic policies."
@@ -66,28 +54,56 @@ template <typename Scheduler,
           template <typename> typename Fiber=minimal_fiber,
           typename Stats=minimal_stats, typename Logging=minimal_logging,
           typename Worker=minimal_worker,
-          typename Interrupt=minimal_interrupt>
+          typename Interrupt=minimal_interrupt,
+          template <typename> typename Deque=dflt_deque,
+          typename Victim_selection=dflt_victim_selection>
 class work_stealing {
 public:
 
   using fiber_type = Fiber<Scheduler>;
 
-  using deque_type = deque<fiber_type>;
+  using deque_type = Deque<fiber_type>;
 
   using buffer_type = ringbuffer<fiber_type*>;
 
-  using elastic_type = Elastic<Stats, Logging>;
+  using elastic_type = Elastic<Stats, Logging, Scheduler>;
+
+  static_assert(deque_type::reports_surplus || ! elastic_type::needs_surplus,
+                "the elastic policy requires a deque that reports surplus transitions");
 
   static
   perworker::array<buffer_type> buffers;
 
   static
   perworker::array<deque_type> deques;
+
+  // fibers injected by threads that are not workers (see pool.hpp),
+  // which idle workers take before they try to steal
+  static
+  mpmc_queue<fiber_type*> injections;
+
+  // true iff a single worker should wait for injected fibers when it
+  // runs out of work, instead of finishing the launch
+  static
+  std::atomic<bool> awaits_injections;
+
+  // Hands a ready fiber to the workers; may be called by any thread,
+  // including threads that are not workers. If the injection queue is
+  // full, the caller waits for the workers to take some of its fibers.
+  static
+  auto inject(fiber_type* f) {
+    assert(f->is_ready());
+    while (! injections.try_push(f)) {
+      std::this_thread::yield();
+    }
+    elastic_type::on_inject();
+  }
   
   static
   auto push(deque_type& d, fiber_type* f) {
     auto r = d.push(f);
-    if (r == deque_surplus_up) {
+    if ((r == deque_surplus_up) ||
+        (elastic_type::notify_on_unknown_surplus && (r == deque_surplus_unknown))) {
       elastic_type::incr_surplus();
     }
   }
@@ -115,6 +131,44 @@ public:
       elastic_type::scale_up();
       f = nullptr;
     }
+    if (f != nullptr) {
+      Stats::increment(Stats::configuration_type::nb_stolen_fibers);
+      Logging::log_fiber_event(fiber_steal, f, nullptr, target_id);
+    }
+    return f;
+  }
+
+  static constexpr
+  size_t max_steal_batch_sz = 64;
+
+  // Steals a batch of fibers from the target, returning the oldest
+  // one and leaving the rest in the buffer of the caller.
+  static
+  auto steal_batch(size_t target_id, size_t max) -> fiber_type* {
+    assert(max <= max_steal_batch_sz);
+    fiber_type* batch[max_steal_batch_sz];
+    auto& d = deques[target_id];
+    auto r = d.steal_batch(batch, max);
+    if (r.second == deque_surplus_down) {
+      elastic_type::decr_surplus(target_id);
+    }
+    auto& my_buffer = buffers.mine();
+    fiber_type* f = nullptr;
+    for (size_t i = 0; i < r.first; i++) {
+      if (batch[i] == &scale_up_fiber<Scheduler>) {
+        elastic_type::scale_up();
+      } else {
+        Logging::log_fiber_event(fiber_steal, batch[i], nullptr, target_id);
+        if (f == nullptr) {
+          f = batch[i];
+        } else {
+          my_buffer.push_back(batch[i]);
+        }
+      }
+    }
+    if (f != nullptr) {
+      Stats::increment(Stats::configuration_type::nb_stolen_fibers, 1 + my_buffer.size());
+    }
     return f;
   }
 
@@ -143,6 +197,36 @@ public:
     return current;
   }
 
+  // Number of bytes used by the deque and the buffer of a given
+  // worker, including the padding added by perworker::array.
+  static
+  auto footprint_szb(size_t id) -> std::pair<size_t, size_t> {
+    auto padded = [] (size_t szb) -> size_t {
+      auto a = TASKPARTS_CACHE_LINE_SZB;
+      return ((szb + a - 1) / a) * a;
+    };
+    auto deque_szb = padded(sizeof(deque_type)) + deques[id].footprint_szb() - sizeof(deque_type);
+    return std::make_pair(deque_szb, padded(sizeof(buffer_type)));
+  }
+
+  static
+  auto output_footprints() {
+    const auto env_p = std::getenv("TASKPARTS_FOOTPRINT_OUTFILE");
+    if (env_p == nullptr) {
+      return;
+    }
+    FILE* f = fopen(env_p, "w");
+    fprintf(f, "[\n");
+    auto nb_workers = perworker::nb_workers();
+    for (size_t i = 0; i < nb_workers; i++) {
+      auto [deque_szb, buffer_szb] = footprint_szb(i);
+      fprintf(f, "{\"worker\": %lu, \"deque_szb\": %lu, \"buffer_szb\": %lu}%s\n",
+	      i, deque_szb, buffer_szb, (i + 1 == nb_workers) ? "" : ",");
+    }
+    fprintf(f, "]\n");
+    fclose(f);
+  }
+
   static
   auto launch() {
     using scheduler_status_type = enum scheduler_status_enum {
@@ -157,20 +241,35 @@ public:
     if (const auto env_p = std::getenv("TASKPARTS_NB_STEAL_ATTEMPTS")) {
       nb_steal_attempts = std::stoi(env_p);
     }
+    // by default, thieves steal one fiber at a time
+    size_t steal_batch_sz = 1;
+    if (const auto env_p = std::getenv("TASKPARTS_STEAL_BATCH_SZ")) {
+      steal_batch_sz = std::max(1, std::stoi(env_p));
+      steal_batch_sz = std::min(steal_batch_sz, max_steal_batch_sz);
+    }
     
     static constexpr
     int not_a_worker = -1;
 
-    auto random_victim = [&] (size_t my_id) -> int {
+    auto select_victim = [&] (size_t my_id) -> int {
       if constexpr (elastic_type::override_rand_worker) {
         return elastic_type::random_worker_with_surplus([&] (size_t id) { return deques[id].empty(); }, my_id);
       } else {
-        return random_other_worker(my_id);
+        return Victim_selection::select(my_id, [&] (size_t id) { return deques[id].size(); });
+      }
+    };
+
+    auto on_steal = [&] (size_t my_id, size_t target_id, bool success) {
+      Victim_selection::on_steal(my_id, target_id, success);
+      if (success) {
+        // counters for steals are ordered by locality level
+        auto c = Stats::configuration_type::nb_steals_l2 + locality_level_of(my_id, target_id);
+        Stats::increment((typename Stats::configuration_type::counter_id_type)c);
       }
     };
 
     auto acquire = [&] {
-      if (nb_workers == 1) {
+      if ((nb_workers == 1) && ! awaits_injections.load()) {
         termination_barrier.set_active(false);
         return scheduler_status_finish;
       }
@@ -186,19 +285,33 @@ public:
         int target = not_a_worker;
         do {
           termination_barrier.set_active(true);
-          current = (target != not_a_worker) ? steal(target) : nullptr;
+          if (target == not_a_worker) {
+            if (! injections.try_pop(current)) {
+              current = nullptr;
+            }
+          } else if (steal_batch_sz == 1) {
+            current = steal(target);
+          } else {
+            current = steal_batch(target, steal_batch_sz);
+          }
+          if (target != not_a_worker) {
+            on_steal(my_id, target, current != nullptr);
+          }
           if (current == nullptr) {
             termination_barrier.set_active(false);
           } else {
-            Stats::increment(Stats::configuration_type::nb_steals);
+            if (target != not_a_worker) {
+              Stats::increment(Stats::configuration_type::nb_steals);
+            }
             elastic_type::decr_stealing(my_id);
             break;
           }
           i--;
-          target = random_victim(my_id);
+          target = (nb_workers == 1) ? not_a_worker : select_victim(my_id);
         } while (i > 0);
         if (termination_barrier.is_terminated()) {
           assert(current == nullptr);
+          elastic_type::on_termination();
           auto t = new terminal_fiber<Scheduler>();
           t->incounter.store(0);
           current = t;
@@ -230,7 +343,9 @@ public:
         while ((current != nullptr) || ! my_deque.empty()) {
           current = (current == nullptr) ? pop(my_id) : current;
           if (current != nullptr) {
+            Logging::log_fiber_event(fiber_enter, current, nullptr, 0);
             auto s = current->exec();
+            Logging::log_fiber_event(fiber_exit, current, nullptr, s);
             if (s == fiber_status_continue) {
               schedule(current);
             } else if (s == fiber_status_pause) {
@@ -269,6 +384,7 @@ public:
     
     Worker::initialize(nb_workers);
     elastic_type::initialize();
+    Victim_selection::initialize(nb_workers);
     Interrupt::initialize_signal_handler();
     termination_barrier.set_active(true);
     for (size_t i = 1; i < nb_workers; i++) {
@@ -282,6 +398,7 @@ public:
       worker_loop(i);
     });
     Worker::destroy();
+    output_footprints();
 #ifndef NDEBUG /*
     for (size_t i = 0; i < buffers.size(); i++) {
       assert(buffers[i].empty());
@@ -327,49 +444,94 @@ public:
     }
   }
 
+  static
+  auto is_deque_empty() -> bool {
+    return deques.mine().empty();
+  }
+
 };
 
 template <typename Scheduler,
           template <typename> typename Fiber,
           typename Stats, typename Logging,
           typename Worker,
-          typename Interrupt>
-perworker::array<typename work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::buffer_type> 
-work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::buffers;
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
+perworker::array<typename work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::buffer_type> 
+work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::buffers;
+
+template <typename Scheduler,
+          template <typename> typename Fiber,
+          typename Stats, typename Logging,
+          typename Worker,
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
+perworker::array<typename work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::deque_type>
+work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::deques;
 
 template <typename Scheduler,
           template <typename> typename Fiber,
           typename Stats, typename Logging,
           typename Worker,
-          typename Interrupt>
-perworker::array<typename work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::deque_type>
-work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::deques;
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
+mpmc_queue<typename work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::fiber_type*>
+work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::injections;
 
 template <typename Scheduler,
           template <typename> typename Fiber,
           typename Stats, typename Logging,
           typename Worker,
-          typename Interrupt>
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
+std::atomic<bool> work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::awaits_injections(false);
+
+template <typename Scheduler,
+          template <typename> typename Fiber,
+          typename Stats, typename Logging,
+          typename Worker,
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
 Fiber<Scheduler>* take() {
-  return work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::take();  
+  return work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::take();  
 }
 
 template <typename Scheduler,
           template <typename> typename Fiber,
           typename Stats, typename Logging,
           typename Worker,
-          typename Interrupt>
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
 void schedule(Fiber<Scheduler>* f) {
-  work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::schedule(f);  
+  work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::schedule(f);  
 }
 
 template <typename Scheduler,
           template <typename> typename Fiber,
           typename Stats, typename Logging,
           typename Worker,
-          typename Interrupt>
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
 void commit() {
-  work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt>::commit();
+  work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::commit();
 }
   
+template <typename Scheduler,
+          template <typename> typename Fiber,
+          typename Stats, typename Logging,
+          typename Worker,
+          typename Interrupt,
+          template <typename> typename Deque,
+          typename Victim_selection>
+bool is_deque_empty() {
+  return work_stealing<Scheduler,Fiber,Stats,Logging,Worker,Interrupt,Deque,Victim_selection>::is_deque_empty();
+}
+
 } // end namespace
@@ -94,21 +94,24 @@ public:
     return (Value)r;
   }
   
+  static constexpr
+  size_t thread_stack_alignb = 16L;
+
+  static constexpr
+  size_t dflt_thread_stack_szb = thread_stack_alignb * (1<<13);
+
+  // prepares ctx to run val->enter(val) on the given call stack,
+  // which the caller allocates
   template <class Value>
   static
-  char* spawn(context_pointer ctx, Value val) {
+  char* spawn(context_pointer ctx, Value val, char* stack, size_t thread_stack_szb) {
     Value target;
     if ((target = (Value)_taskparts_ctx_save(ctx))) {
       target->enter(target);
       assert(false);
     }
     static constexpr
-    size_t thread_stack_alignb = 16L;
-    static constexpr
-    size_t thread_stack_szb = thread_stack_alignb * (1<<13);
-    static constexpr
     int _X86_64_SP_OFFSET = 6;
-    char* stack = (char*)malloc(thread_stack_szb);
     char* sp = &stack[thread_stack_szb];
     sp = (char*)((uintptr_t)sp & -thread_stack_alignb);  // align stack pointer on 16-byte boundary
     sp -= 128; // for red zone
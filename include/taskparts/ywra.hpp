@@ -4,6 +4,7 @@
 #include <memory>
 #include <assert.h>
 #include <array>
+#include <algorithm>
 
 #include "perworker.hpp"
 #include "fixedcapacity.hpp"
@@ -13,9 +14,12 @@
 namespace taskparts {
 
 // Deque from Yue Yao, Sam Westrick, Mike Rainey, and Umut Acar (2022)
-template <typename Fiber>
+template <typename Fiber, typename Layout>
 struct ywra {
   
+  static constexpr
+  bool reports_surplus = true;
+  
   using qidx = uint16_t;
   
   // use std::atomic<age_t> for atomic access.
@@ -28,15 +32,16 @@ struct ywra {
   };
   
   // align to avoid false sharing
-  struct alignas(64) padded_fiber {
+  struct alignas(Layout::slot_align_szb) padded_fiber {
     std::atomic<Fiber*> f;
   };
 
   static constexpr
   int max_sz = (1 << 14); // can in principle be up to 2^16
   
-  std::atomic<age_t> age;
+  alignas(Layout::index_align_szb) std::atomic<age_t> age;
   
+  alignas(std::max(Layout::index_align_szb, alignof(padded_fiber)))
   std::array<padded_fiber, max_sz> deq;
   std::array<Fiber*, max_sz> backup_deq;
   
@@ -55,6 +60,10 @@ struct ywra {
     return size() == 0;
   }
 
+  auto footprint_szb() -> size_t {
+    return sizeof(*this);
+  }
+
   auto relocate() -> age_t {
     auto freeze = [&] () -> age_t {
       auto orig = age.load();
@@ -167,6 +176,277 @@ struct ywra {
     auto r = (size(orig) == 1) ? deque_surplus_down : deque_surplus_stable;
     return std::make_pair(f, r);
   }
+
+  // Steals up to half of the items, but no more than max, writing
+  // them oldest first to dst. Every operation on the deque updates
+  // age, and so a single CAS claims the whole batch.
+  auto steal_batch(Fiber** dst, size_t max) -> std::pair<size_t, deque_surplus_result_type> {
+    auto orig = age.load();
+    auto sz = size(orig);
+    if (sz == 0) {
+      return std::make_pair(0, deque_surplus_stable);
+    }
+    size_t n = std::min((size_t)std::max(sz / 2, 1u), max);
+    for (size_t i = 0; i < n; i++) {
+      dst[i] = deq[orig.top + i].f.load(std::memory_order_relaxed);
+    }
+    auto next = orig;
+    next.top += n;
+    next.tag = orig.tag + 1;
+    if (! age.compare_exchange_strong(orig, next)) {
+      return std::make_pair(0, deque_surplus_stable);
+    }
+    auto r = (size(next) == 0) ? deque_surplus_down : deque_surplus_stable;
+    return std::make_pair(n, r);
+  }
+  
+};
+
+/*---------------------------------------------------------------------*/
+/* Growable variant of the YWRA deque
+ *
+ * Same age/tag protocol as ywra, except that the array of items
+ * starts small. When the owner pushes onto the end of the array, it
+ * freezes the deque (as in ywra::relocate), and then either shifts
+ * the items to the front of the array, in place, or, if the array is
+ * more than half full, moves them to an array of twice the capacity.
+ * Thieves that observed the age before the freeze fail their CAS, but
+ * may still read from the previous array, and so retired arrays are
+ * kept until the deque is destroyed; their total size is bounded by
+ * the size of the current array.
+ */
+
+template <typename Fiber, typename Layout>
+struct ywra_growable {
+  
+  static constexpr
+  bool reports_surplus = true;
+  
+  using qidx = uint32_t;
+
+  // top and bot are bitfields that share the 64-bit age word with the
+  // tag, so that the capacity is not limited to what 16-bit indices
+  // allow; the tag takes the remaining bits, and wraps around
+  static constexpr
+  int qidx_bits = 25;
+  
+  struct alignas(int64_t) age_t {
+    uint64_t tag : 64 - 2 * qidx_bits;
+    uint64_t bot : qidx_bits;
+    uint64_t top : qidx_bits;
+  };
+
+  static_assert(sizeof(age_t) == sizeof(int64_t));
+  
+  struct alignas(Layout::slot_align_szb) padded_fiber {
+    std::atomic<Fiber*> f;
+  };
+
+  class array_type {
+  private:
+
+    std::unique_ptr<padded_fiber[]> items;
+
+  public:
+
+    std::unique_ptr<array_type> previous;
+
+    size_t capacity;
+
+    array_type(size_t capacity)
+      : items(new padded_fiber[capacity]), capacity(capacity) { }
+
+    auto get(size_t i) -> Fiber* {
+      return items[i].f.load(std::memory_order_relaxed);
+    }
+
+    auto put(size_t i, Fiber* f) {
+      items[i].f.store(f, std::memory_order_relaxed);
+    }
+
+    auto footprint_szb() -> size_t {
+      auto szb = sizeof(*this) + capacity * sizeof(padded_fiber);
+      return szb + (previous ? previous->footprint_szb() : 0);
+    }
+    
+  };
+
+  static constexpr
+  size_t initial_capacity = 64;
+
+  // the largest power of two that bot can index past
+  static constexpr
+  size_t max_capacity = ((size_t)1 << (qidx_bits - 1));
+  
+  alignas(Layout::index_align_szb) std::atomic<age_t> age;
+
+  alignas(Layout::index_align_szb) std::atomic<array_type*> deq;
+  
+  ywra_growable()
+    : age(age_t{0, 0, 0}), deq(new array_type(initial_capacity)) { }
+
+  ~ywra_growable() {
+    delete deq.load(std::memory_order_relaxed);
+  }
+  
+  auto size(age_t a) -> unsigned int {
+    assert(a.bot >= a.top);
+    return a.bot - a.top;
+  }
+
+  auto size() -> unsigned int {
+    return size(age.load());
+  }
+  
+  auto empty() -> bool {
+    return size() == 0;
+  }
+
+  auto footprint_szb() -> size_t {
+    return sizeof(*this) + deq.load()->footprint_szb();
+  }
+
+  // returns the (frozen) age after relocation along with the number
+  // of items, which now occupy the front of the array
+  auto relocate() -> std::pair<age_t, qidx> {
+    auto orig = age.load();
+    auto next = orig;
+    while (true) {
+      next.top = 0;
+      next.bot = 0;
+      next.tag = orig.tag + 1;
+      if (age.compare_exchange_strong(orig, next)) {
+        break;
+      }
+    }
+    auto n = size(orig);
+    auto a = deq.load(std::memory_order_relaxed);
+    if (n > (a->capacity / 2)) {
+      if (a->capacity == max_capacity) {
+        taskparts_die("internal error: scheduler queue overflow\n");
+      }
+      auto b = new array_type(2 * a->capacity);
+      b->previous.reset(a);
+      for (qidx i = 0; i < n; i++) {
+        b->put(i, a->get(orig.top + i));
+      }
+      deq.store(b, std::memory_order_release);
+    } else {
+      for (qidx i = 0; i < n; i++) {
+        a->put(i, a->get(orig.top + i));
+      }
+    }
+    return std::make_pair(next, n);
+  }
+
+  auto reset_on_sz_zero(age_t orig) -> age_t {
+    if (size(orig) > 0) {
+      return orig;
+    }
+    auto next = orig;
+    next.top = 0;
+    next.bot = 0;
+    next.tag = orig.tag + 1;
+    if (! age.compare_exchange_strong(orig, next)) {
+      taskparts_die("bogus");
+    }
+    return next;
+  }
+  
+  auto push(Fiber* f) -> deque_surplus_result_type {
+    auto orig = reset_on_sz_zero(age.load());
+    auto a = deq.load(std::memory_order_relaxed);
+    if (orig.bot == a->capacity) {
+      auto [frozen, n] = relocate();
+      a = deq.load(std::memory_order_relaxed);
+      // while frozen, the deque appears empty to thieves, and so no
+      // other worker can update age
+      a->put(n, f);
+      auto next = frozen;
+      next.bot = n + 1;
+      next.tag = frozen.tag + 1;
+      if (! age.compare_exchange_strong(frozen, next)) {
+        taskparts_die("bogus");
+      }
+      return (n == 0) ? deque_surplus_up : deque_surplus_stable;
+    }
+    auto next = orig;
+    next.bot++;
+    next.tag = orig.tag + 1;
+    a->put(orig.bot, f);
+    while (true) {
+      if (age.compare_exchange_strong(orig, next)) {
+        break;
+      }
+      next.top = orig.top;
+      next.tag = orig.tag + 1;
+    }
+    assert(size(orig) + 1 == size(next));
+    return (size(orig) == 0) ? deque_surplus_up : deque_surplus_stable;
+  }
+  
+  auto pop() -> std::pair<Fiber*, deque_surplus_result_type> {
+    auto orig = reset_on_sz_zero(age.load());
+    if (size(orig) == 0) {
+      return std::make_pair(nullptr, deque_surplus_stable);
+    }
+    auto next = orig;
+    next.bot--;
+    next.tag = orig.tag + 1;
+    auto f = deq.load(std::memory_order_relaxed)->get(next.bot);
+    assert(f != nullptr);
+    while (true) {
+      if (age.compare_exchange_strong(orig, next)) {
+        break;
+      }
+      next.top = orig.top;
+      next.tag = orig.tag + 1;
+      assert((orig.bot - 1) == next.bot);
+      if (size(orig) == 0) {
+        return std::make_pair(nullptr, deque_surplus_stable);
+      }
+    }
+    auto r = (size(orig) == 1) ? deque_surplus_down : deque_surplus_stable;
+    return std::make_pair(f, r);
+  }
+  
+  auto steal() -> std::pair<Fiber*, deque_surplus_result_type> {
+    auto orig = age.load();
+    if (size(orig) == 0) {
+      return std::make_pair(nullptr, deque_surplus_stable);
+    }
+    auto next = orig;
+    auto f = deq.load(std::memory_order_acquire)->get(next.top);
+    next.top++;
+    next.tag = orig.tag + 1;
+    if (! age.compare_exchange_strong(orig, next)) {
+      return std::make_pair(nullptr, deque_surplus_stable);
+    }
+    auto r = (size(orig) == 1) ? deque_surplus_down : deque_surplus_stable;
+    return std::make_pair(f, r);
+  }
+
+  // See ywra::steal_batch().
+  auto steal_batch(Fiber** dst, size_t max) -> std::pair<size_t, deque_surplus_result_type> {
+    auto orig = age.load();
+    auto sz = size(orig);
+    if (sz == 0) {
+      return std::make_pair(0, deque_surplus_stable);
+    }
+    size_t n = std::min((size_t)std::max(sz / 2, 1u), max);
+    auto a = deq.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+      dst[i] = a->get(orig.top + i);
+    }
+    auto next = orig;
+    next.top += n;
+    next.tag = orig.tag + 1;
+    if (! age.compare_exchange_strong(orig, next)) {
+      return std::make_pair(0, deque_surplus_stable);
+    }
+    auto r = (size(next) == 0) ? deque_surplus_down : deque_surplus_stable;
+    return std::make_pair(n, r);
+  }
   
 };
 